@@ -20,6 +20,8 @@
 ###############################################################################
 # debug = 1 will include string debugging for terminal/sushi/sashimi
 debug = 0
+# trace = 1 builds in the hot path trace, see trace.h. Dump it with tracedump
+trace = 0
 # compiler_vcc = 1 will trigger VBCC, else GCC
 compiler_vcc = 1
 
@@ -131,6 +133,11 @@ CFLAGS2 += -DDEBUG -g
 LINKLIBS = -L$(PREFX)/lib -ldebug
 endif
 
+ifeq ($(trace),1)
+CFLAGS  += -DSCSIDAYNA_TRACE
+CFLAGS2 += -DSCSIDAYNA_TRACE
+endif
+
 ###############################################################################
 #
 # compiler flags and optimization levels
@@ -148,7 +155,7 @@ LDFLAGS =
 ###############################################################################
 # ASM based alternative to deviceheader.o would be romtag.o
 
-OBJECTS = deviceheader.o deviceinit.o device.o scsiwifi.o
+OBJECTS = deviceheader.o deviceinit.o device.o scsiwifi.o trace.o
 OBJECTS += $(ASMOBJECTS)
 
 # used for secondary build
@@ -164,7 +171,7 @@ all:	$(DEVICEID) $(DEVICEID2) $(TESTTOOL) $(TESTTOOL2)
 
 clean:
 	rm -f $(OBJECTS) $(OBJECTS2)
-	rm -f $(DEVICEID) $(DEVICEID2) $(EXTRACLEAN)
+	rm -f $(DEVICEID) $(DEVICEID2) $(TESTTOOL) $(EXTRACLEAN)
 
 # not for cross compile :-)
 install: $(DEVICEID) $(DEVICEID2)
@@ -178,6 +185,9 @@ $(DEVICEID) : $(OBJECTS)
 	$(LINK) $(LDFLAGS) -o $@ $(OBJECTS) $(LINKLIBS) $(LINKOPTS)
 
 
+$(TESTTOOL) : $(TESTTOOL).c trace.h
+	$(LINKEXE) $(CFLAGS) $(IPATH) -o $@ $<
+
 # separate ruleset for each subdirectory, ./src overrides all other paths for priority
 # of platform-optimized routines
 
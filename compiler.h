@@ -19,6 +19,25 @@
 #ifndef _INC_ASMINTERFACE_H
 #define _INC_ASMINTERFACE_H
 
+#ifdef SCSIDAYNA_HOST
+
+/* host (Linux) build, see host/: no registers, no small data */
+#define ASM
+#define ASMR(x)
+#define ASMREG(x)
+#define SAVEDS
+#define STRUCTOFFSET(_a_,_b_) offsetof(struct _a_, _b_)
+#include <stddef.h>
+#define INLINE static inline
+#ifndef __saveds
+#define __saveds
+#endif
+#ifndef __reg
+#define __reg(x)
+#endif
+
+#else /* SCSIDAYNA_HOST */
+
 #ifdef __SASC
 
 #define ASM __asm
@@ -61,5 +80,12 @@
 #endif /* __GNUC__ */
 #endif /* __SASC */
 
+/* an integer a pointer fits in, as the host shim (and AROS) have it */
+#ifndef IPTR
+#define IPTR ULONG
+#endif
+
+#endif /* SCSIDAYNA_HOST */
+
 
 #endif /* _INC_ASMINTERFACE_H */
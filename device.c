@@ -87,16 +87,37 @@ struct ProcInit
 
 // Free's anything left after init
 void freeInit(DEVBASEP) {
+  if (db->db_ScsiDevice) SCSIWifi_close(db->db_ScsiDevice);
+  db->db_ScsiDevice = NULL;
   if (db->db_scsiSettings) FreeVec(db->db_scsiSettings); 
   db->db_scsiSettings = NULL;
   if (DOSBase) CloseLibrary(DOSBase); 
   DOSBase = NULL;
   if (UtilityBase) CloseLibrary(UtilityBase); 
   UtilityBase = NULL;
+#ifdef SCSIDAYNA_TRACE
+  if (db->db_Trace) FreeVec(db->db_Trace);
+#endif
+  db->db_Trace = NULL;
 }
 
 
 void DevTermIO( DEVBASEP, struct IORequest *ioreq );
+BOOL filter_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm);
+void stamp_write(DEVBASEP, struct IOSana2Req *ior);
+BOOL unstamp_write(DEVBASEP, struct IOSana2Req *ior, ULONG* queued);
+ULONG read_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm, USHORT packetSize);
+struct ReadTypeQueue* find_read_queue(DEVBASEP, ULONG packetType, BOOL create);
+struct TrackedType* find_tracked_type(DEVBASEP, ULONG packetType);
+void count_type(DEVBASEP, UBYTE* frame, USHORT size, BOOL sent, BOOL dropped);
+BYTE change_multicasts(DEVBASEP, UBYTE* low, UBYTE* high, BOOL add);
+BOOL multicast_wanted(DEVBASEP, UBYTE* address);
+BOOL frame_wanted(DEVBASEP, UBYTE* address);
+void push_multicasts(DEVBASEP, SCSIWIFIDevice scsiDevice);
+void update_samplers(DEVBASEP, struct timeval* now);
+void reject_list(DEVBASEP, struct List* list);
+void abort_list(DEVBASEP, struct List* list);
+void rejectAllPackets(DEVBASEP);
 
 __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
                                  ASMR(a0) BPTR seglist              ASMREG(a0),
@@ -107,6 +128,8 @@ __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
   db->db_UtilityBase = NULL;
   db->db_scsiSettings = NULL;
   db->db_online = 0;
+  db->db_Trace = NULL;
+  db->db_TraceOpens = 0;
 
   volatile struct List db_EventList;
 	struct SignalSemaphore db_EventListSem;     
@@ -132,6 +155,13 @@ __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
     return 0;
   }
   struct ScsiDaynaSettings* settings = (struct ScsiDaynaSettings*)db->db_scsiSettings;
+
+#ifdef SCSIDAYNA_TRACE
+  // The ring is allocated up front so recording never allocates.  Tracing is just unavailable without it
+  if (db->db_Trace = (struct TraceRing*)AllocVec(sizeof(struct TraceRing), MEMF_CLEAR|MEMF_PUBLIC)) {
+    db->db_Trace->tr_SysBase = db->db_SysBase;
+  } else D(("scsidayna: Out of memory (trace)\n"));
+#endif
  
   if (SCSIWifi_loadSettings((void*)UtilityBase, (void*)DOSBase, settings))
     D(("scsidayna: settings loaded")); else D(("scsidayna: Invalid or missing settings file, reverting to defaults\n"));
@@ -148,21 +178,36 @@ __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
   openData.dosBase = (void*)DOSBase;
   openData.deviceDriverName = settings->deviceName;
   openData.deviceID = settings->deviceID;
-  openData.scsiMode = settings->scsiMode;
-  db->db_scsiMode = settings->scsiMode;
+  openData.batch = settings->batch;
 
   
   enum SCSIWifi_OpenResult scsiResult;
   SCSIWIFIDevice* wifiDevice;
+  char cachedSignature[SCSIWIFI_SIGNATURE_SIZE+1], signature[SCSIWIFI_SIGNATURE_SIZE+1];
+  USHORT cachedMode, scsiMode = settings->scsiMode;
+  LONG cachedID = SCSIWifi_loadDetected((void*)UtilityBase, (void*)DOSBase, settings->deviceName, cachedSignature, &cachedMode);
+  UBYTE remember = 0;
+
+  // Until it's calibrated any mode will do, as nothing's read
+  if (scsiMode == SCSIWIFI_MODE_AUTO) scsiMode = (cachedMode == SCSIWIFI_MODE_AUTO) ? SCSIWifi_guessMode((void*)UtilityBase, settings->deviceName) : cachedMode;
+  openData.scsiMode = scsiMode;
   
   if ((settings->deviceID<0) || (settings->deviceID>7)) {
-    D(("scsidayna: Searching for DaynaPORT Device to Configure\n"));
-    // Highly likely it will be on 4 as its in the example so start there!
-    for (USHORT deviceID=4; deviceID<4+8; deviceID++) {
-      openData.deviceID = deviceID & 7;  
-      D(("scsidayna: Searching on DeviceID %ld\n", openData.deviceID));
+    wifiDevice = NULL;
+    // Where it was last time is the likeliest place
+    if (cachedID >= 0) {
+      D(("scsidayna: Trying DeviceID %ld from last time\n", cachedID));
+      openData.deviceID = cachedID;
       wifiDevice = SCSIWifi_open(&openData, &scsiResult);
-      if (wifiDevice) break;
+    }
+    if (!wifiDevice) {
+      D(("scsidayna: Searching for DaynaPORT Device to Configure\n"));
+      openData.deviceID = SCSIWifi_findDevice(&openData, cachedID, signature);
+      if (openData.deviceID >= 0) wifiDevice = SCSIWifi_open(&openData, &scsiResult); else scsiResult = sworNotDaynaDevice;
+    }
+    if ((wifiDevice) && (openData.deviceID != cachedID)) {
+      D(("scsidayna: Found on DeviceID %ld, remembering it\n", openData.deviceID));
+      remember = 1;
     }
   } else {
     D(("scsidayna: Opening Device to Configure\n"));
@@ -184,6 +229,32 @@ __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
   }
   db->db_scsiDeviceID = openData.deviceID;
 
+  // New firmware may behave differently, so what was found before goes
+  SCSIWifi_getSignature(wifiDevice, signature);
+  if (strcmp(signature, cachedSignature)) {
+    cachedMode = SCSIWIFI_MODE_AUTO;
+    remember = 1;
+  }
+  // MODE=-1 uses what the driver is known to need, or what worked best last time with this driver and firmware, or finds out
+  if ((settings->scsiMode == SCSIWIFI_MODE_AUTO) && (cachedMode == SCSIWIFI_MODE_AUTO) && (SCSIWifi_getTransport(wifiDevice)->scsiMode == SCSIWIFI_MODE_AUTO)) {
+    ULONG readTicks[SCSIWIFI_MODE_COUNT];
+    LONG best = SCSIWifi_calibrate(wifiDevice, readTicks);
+    if (best == SCSIWIFI_CALIBRATE_WEDGED) {
+      D(("scsidayna: A calibration READ hung the controller, MODE needs setting by hand\n"));
+      SCSIWifi_close(wifiDevice);
+      freeInit(db);
+      return 0;
+    }
+    D(("scsidayna: Calibrated, %ld reads took %ld/%ld/%ld EClock ticks in each MODE\n", (LONG)SCSIWIFI_CALIBRATE_READS, readTicks[0], readTicks[1], readTicks[2]));
+    if (best >= 0) {
+      D(("scsidayna: Using MODE=%ld, remembering it\n", best));
+      scsiMode = cachedMode = best;
+      remember = 1;
+    } else D(("scsidayna: No MODE worked, trying %ld\n", (LONG)scsiMode));
+  }
+  db->db_scsiMode = scsiMode;
+  if (remember) SCSIWifi_saveDetected((void*)DOSBase, settings->deviceName, openData.deviceID, signature, cachedMode);
+
   D(("scsidayna: successfully opened. Fetching MAC\n"));
 
   // Device open. Fetch MAC address
@@ -215,10 +286,15 @@ __saveds struct Device *DevInit( ASMR(d0) DEVBASEP                  ASMREG(d0),
     }
   }
 
-  D(("scsidayna: Closing Device\n"));
-  SCSIWifi_close(wifiDevice);
+  // The device stays open for frame_proc, so it doesn't have to find and INQUIRY it again each time
+  // it starts.  Until one adopts it nobody's waiting for its replies
+  SCSIWifi_release(wifiDevice);
+  db->db_ScsiDevice = wifiDevice;
+  InitSemaphore(&db->db_ProcSem);
+  InitSemaphore(&db->db_ActiveSem);
+  db->db_Lingering = LINGER_NO;
 
-  D(("scsidayna: Closed\n"));
+  D(("scsidayna: Ready\n"));
 	return (struct Device*)db;
 }
 
@@ -230,34 +306,57 @@ __saveds LONG DevOpen( ASMR(a1) struct IOSana2Req *ioreq           ASMREG(a1),
 	LONG ok = 0,ret = IOERR_OPENFAIL;
   struct BufferManagement *bm;
 
-  // promiscuous mode not supported
-  if ((flags & SANA2OPF_PROM) && (unit)) {
-      ioreq->ios2_Req.io_Error = IOERR_OPENFAIL;
-      ioreq->ios2_Req.io_Unit = (struct Unit *) 0;
-      ioreq->ios2_Req.io_Device = (struct Device *) 0;
-      D(("scsidayna: SANA2OPF_PROM not supported %ld\n",unit));
-      return IOERR_OPENFAIL;
-  }
-
 	D(("scsidayna: DevOpen for %ld\n",unit));
 
 	db->db_Lib.lib_OpenCnt++; /* avoid Expunge, see below for separate "unit" open count */
 
-  if (unit==0 && db->db_Lib.lib_OpenCnt==1) {
+  if (unit == S2_DAYNA_TRACE_UNIT) {
+    // Only for S2_DAYNA_TRACE, so it doesn't count against the one opener unit 0 takes
+    db->db_TraceOpens++;
+    ioreq->ios2_Req.io_Error = 0;
+    ioreq->ios2_Req.io_Unit = (struct Unit *)(IPTR)unit;
+    ioreq->ios2_Req.io_Device = (struct Device *)db;
+    ok = 1;
+  } else if (unit==0 && db->db_Lib.lib_OpenCnt - db->db_TraceOpens == 1) {
     if ((bm = (struct BufferManagement*)AllocVec(sizeof(struct BufferManagement), MEMF_CLEAR|MEMF_PUBLIC))) {
+      // frame_proc may still be lingering from the last close.  If so it's kept, and waits while this is set up
+      BOOL warm;
+      Forbid();
+      if ((warm = (db->db_Proc != NULL))) db->db_Lingering = LINGER_CLAIMED;
+      Permit();
+
       bm->bm_CopyToBuffer = (BMFunc)GetTagData(S2_CopyToBuff, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
       bm->bm_CopyFromBuffer = (BMFunc)GetTagData(S2_CopyFromBuff, 0, (struct TagItem *)ioreq->ios2_BufferManagement); 
+      bm->bm_CopyToBuffer16 = (BMFunc)GetTagData(S2_CopyToBuff16, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
+      bm->bm_CopyFromBuffer16 = (BMFunc)GetTagData(S2_CopyFromBuff16, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
+      bm->bm_CopyToBuffer32 = (BMFunc)GetTagData(S2_CopyToBuff32, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
+      bm->bm_CopyFromBuffer32 = (BMFunc)GetTagData(S2_CopyFromBuff32, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
+      bm->bm_PacketFilter = (struct Hook*)GetTagData(S2_PacketFilter, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
+      bm->bm_DMACopyFromBuffer32 = (BMDMAFunc)GetTagData(S2_DMACopyFromBuff32, 0, (struct TagItem *)ioreq->ios2_BufferManagement);
 
       ioreq->ios2_BufferManagement = (VOID *)bm;
       ioreq->ios2_Req.io_Error = 0;
-      ioreq->ios2_Req.io_Unit = (struct Unit *)unit; // not a real pointer, but id integer
+      ioreq->ios2_Req.io_Unit = (struct Unit *)(IPTR)unit; // not a real pointer, but id integer
       ioreq->ios2_Req.io_Device = (struct Device *)db;
 
       NewList(&db->db_ReadList);
       InitSemaphore(&db->db_ReadListSem);
+      for (int i=0; i<READ_TYPE_SLOTS; i++) {
+        db->db_ReadTypes[i].rq_InUse = 0;
+        NewList(&db->db_ReadTypes[i].rq_Requests);
+        NewList(&db->db_ReadTypes[i].rq_Held);
+      }
+
+      // The receive pool.  Without it frames nobody's waiting for are just dropped, as before
+      NewList(&db->db_RxPoolFree);
+      USHORT poolSize = ((struct ScsiDaynaSettings*)db->db_scsiSettings)->rxPool;
+      if ((poolSize) && ((db->db_RxPool) || (db->db_RxPool = (struct HeldFrame*)AllocVec(sizeof(struct HeldFrame) * poolSize, MEMF_PUBLIC)))) {
+        for (USHORT i=0; i<poolSize; i++) AddTail(&db->db_RxPoolFree, (struct Node*)&db->db_RxPool[i]);
+      } else if (poolSize) D(("scsidayna: Out of memory (receive pool)\n"));
 
       NewList(&db->db_WriteList);
       InitSemaphore(&db->db_WriteListSem);
+      memset(db->db_WriteStamps, 0, sizeof(db->db_WriteStamps));
 
       NewList(&db->db_EventList);
       InitSemaphore(&db->db_EventListSem);
@@ -265,13 +364,36 @@ __saveds LONG DevOpen( ASMR(a1) struct IOSana2Req *ioreq           ASMREG(a1),
       NewList(&db->db_ReadOrphanList);
       InitSemaphore(&db->db_ReadOrphanListSem);
 
-      InitSemaphore(&db->db_ProcSem);
+      // Promiscuous: every frame the DaynaPORT passes on goes to the stack, whoever it's for
+      db->db_Promiscuous = (flags & SANA2OPF_PROM) ? 1 : 0;
+      if (db->db_Promiscuous) D(("scsidayna: promiscuous\n"));
+
+      memset(db->db_MulticastTable, 0, sizeof(db->db_MulticastTable));
+      db->db_Multicasts = 0;
+      db->db_MulticastFiltering = 0;
+      db->db_MulticastsChanged = 0;
+      InitSemaphore(&db->db_MulticastSem);
+
+      memset(db->db_TypeStats, 0, sizeof(db->db_TypeStats));
+      db->db_TrackedTypes = 0;
+      InitSemaphore(&db->db_TypeStatsSem);
+
+      NewList(&db->db_SampleList);
+      InitSemaphore(&db->db_SampleListSem);
+
       db->db_online = 1;
 
       struct ProcInit init;
       struct MsgPort *port;
 
-      if (port = CreateMsgPort()) {
+      if (warm) {
+        D(("scsidayna: frame_proc still running\n"));
+        db->db_Lingering = LINGER_NO;
+        Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_F);
+        ret = 0;
+        ok = 1;
+      } else if (port = CreateMsgPort()) {
+        db->db_Lingering = LINGER_NO;
         D(("scsidayna: Starting Server\n"));
         if (db->db_Proc = CreateNewProcTags(NP_Entry, frame_proc, NP_Name,
                                             frame_proc_name, NP_Priority, 0, TAG_DONE)) {
@@ -287,6 +409,14 @@ __saveds LONG DevOpen( ASMR(a1) struct IOSana2Req *ioreq           ASMREG(a1),
 
           if (init.error) {
             D(("scsidayna:process startup error\n"));
+            // It's gone, or going: wait it out so the next DevOpen starts a fresh one and DevExpunge isn't held up
+            db->db_Proc = NULL;
+            ObtainSemaphore(&db->db_ProcSem);
+            ReleaseSemaphore(&db->db_ProcSem);
+            if (db->db_RxPool) {
+              FreeVec(db->db_RxPool);
+              db->db_RxPool = NULL;
+            }
             ret = IOERR_OPENFAIL;
             ok = 0;
           } else {
@@ -334,16 +464,41 @@ __saveds BPTR DevClose(   ASMR(a1) struct IORequest *ioreq        ASMREG(a1),
 
 	db->db_Lib.lib_OpenCnt--;
 
-  if (db->db_Lib.lib_OpenCnt == 0) {
+  if ((ULONG)(IPTR)ioreq->io_Unit == S2_DAYNA_TRACE_UNIT) db->db_TraceOpens--; else
+  if (db->db_Lib.lib_OpenCnt == db->db_TraceOpens) {
 
-    if (db->db_Proc) {
-      D(("scsidayna: End Proc...\n"));
-      Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_C);
-      db->db_Proc = 0;
+    if ((db->db_Proc) && (((struct ScsiDaynaSettings*)db->db_scsiSettings)->linger)) {
+      // frame_proc stays for a while in case it's opened again.  Once it lets go of db_ActiveSem it's
+      // finished with the lists, and it frees the pool itself if it's not opened again in time
+      D(("scsidayna: Proc lingering...\n"));
+      db->db_Lingering = LINGER_YES;
+      Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_F);
+      ObtainSemaphore(&db->db_ActiveSem);
+      ReleaseSemaphore(&db->db_ActiveSem);
+    } else {
+      if (db->db_Proc) {
+        D(("scsidayna: End Proc...\n"));
+        Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_C);
+        db->db_Proc = 0;
+
+        ObtainSemaphore(&db->db_ProcSem);
+        ReleaseSemaphore(&db->db_ProcSem);
+      }   
+      if (db->db_RxPool) {
+        FreeVec(db->db_RxPool);
+        db->db_RxPool = NULL;
+      }
+    }
 
-      ObtainSemaphore(&db->db_ProcSem);
-      ReleaseSemaphore(&db->db_ProcSem);
-    }   
+    // frame_proc is done with the lists either way.  Whatever the last opener left queued goes back
+    // to it now, so a lingering frame_proc can't answer it and the next DevOpen doesn't drop it
+    ObtainSemaphore(&db->db_EventListSem);
+    abort_list(db, (struct List*)&db->db_EventList);
+    ReleaseSemaphore(&db->db_EventListSem);
+    rejectAllPackets(db);
+    ObtainSemaphore(&db->db_SampleListSem);
+    reject_list(db, (struct List*)&db->db_SampleList);
+    ReleaseSemaphore(&db->db_SampleListSem);
   }
 
 	ioreq->io_Device = (0);
@@ -364,6 +519,13 @@ __saveds BPTR DevExpunge( ASMR(a6) DEVBASEP                        ASMREG(a6) )
 		db->db_Lib.lib_Flags |= LIBF_DELEXP;
 		return (0);
 	}
+	// A lingering frame_proc can't be waited for here, so it's told to go and the expunge is left for next time
+	if( db->db_Proc )
+	{
+		Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_C);
+		db->db_Lib.lib_Flags |= LIBF_DELEXP;
+		return (0);
+	}
 
   D(("scsidayna: Remove Device Node...\n"));
   Remove((struct Node*)db);
@@ -374,18 +536,67 @@ __saveds BPTR DevExpunge( ASMR(a6) DEVBASEP                        ASMREG(a6) )
 	return seglist;
 }
 
+// Names for the histogram records.  These match SCSIWIFI_HISTOGRAM_BUCKETS and SCSIWIFI_HISTOGRAM_SHIFT
+#define HISTOGRAM_NAMES(what) \
+  what ", under 64 EClocks",     what ", under 128 EClocks",    what ", under 256 EClocks",    what ", under 512 EClocks", \
+  what ", under 1K EClocks",     what ", under 2K EClocks",     what ", under 4K EClocks",     what ", under 8K EClocks", \
+  what ", under 16K EClocks",    what ", under 32K EClocks",    what ", under 64K EClocks",    what ", under 128K EClocks", \
+  what ", under 256K EClocks",   what ", under 512K EClocks",   what ", under 1M EClocks",     what ", 1M EClocks or more"
+
+static const char* histogram_names[shCount][SCSIWIFI_HISTOGRAM_BUCKETS] = {
+  {HISTOGRAM_NAMES("SCSI READ")},
+  {HISTOGRAM_NAMES("SCSI WRITE FRAME")},
+  {HISTOGRAM_NAMES("Other SCSI commands")},
+  {HISTOGRAM_NAMES("CMD_WRITE queued to replied")},
+  {HISTOGRAM_NAMES("Frame read to CMD_READ replied")}
+};
+
+static const char* rssi_history_names[RSSI_HISTORY] = {
+  "Signal strength (dBm), last check", "Signal strength, 1 check before", "Signal strength, 2 checks before", "Signal strength, 3 checks before",
+  "Signal strength, 4 checks before", "Signal strength, 5 checks before", "Signal strength, 6 checks before", "Signal strength, 7 checks before"
+};
+
+// Adds a record to a S2_GETSPECIALSTATS reply if there's room for it
+void add_special(struct Sana2SpecialStatHeader* header, ULONG type, ULONG count, const char* name)
+{
+  struct Sana2SpecialStatRecord* record;
+  if (header->RecordCountSupplied >= header->RecordCountMax) return;
+  record = (struct Sana2SpecialStatRecord*)(header + 1) + header->RecordCountSupplied++;
+  record->Type = type;
+  record->Count = count;
+  record->String = (STRPTR)name;
+}
+
+// The low word of the EClock, which is plenty for timing anything shorter than an hour.  0 if frame_proc isn't running
+ULONG eclock_now(DEVBASEP)
+{
+  struct Library *TimerBase = db->db_TimerBase;
+  struct EClockVal now;
+  if (!TimerBase) return 0;
+  ReadEClock(&now);
+  return now.ev_lo;
+}
+
 __saveds VOID DevBeginIO( ASMR(a1) struct IOSana2Req *ioreq       ASMREG(a1),
                             ASMR(a6) DEVBASEP                       ASMREG(a6) )
 {
-	ULONG unit = (ULONG)ioreq->ios2_Req.io_Unit;
+	ULONG unit = (ULONG)(IPTR)ioreq->ios2_Req.io_Unit;
   int mtu;
+  struct ReadTypeQueue* queue;
+  struct TrackedType* tracked = NULL;
 
 	ioreq->ios2_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
   ioreq->ios2_Req.io_Error = S2ERR_NO_ERROR;
-  ioreq->ios2_WireError = S2WERR_GENERIC_ERROR;
+  // S2_ONEVENT's events to wait for come in here
+  if (ioreq->ios2_Req.io_Command != S2_ONEVENT) ioreq->ios2_WireError = S2WERR_GENERIC_ERROR;
 
 	//D(("BeginIO command %ld unit %ld\n",(LONG)ioreq->ios2_Req.io_Command,unit));
+  TRACE(db->db_Trace, teBeginIO, ioreq->ios2_Req.io_Command, ioreq);
 
+  // The trace unit has no buffers or frame_proc behind it
+  if ((unit == S2_DAYNA_TRACE_UNIT) && (ioreq->ios2_Req.io_Command != S2_DAYNA_TRACE)) {
+    ioreq->ios2_Req.io_Error = S2ERR_NOT_SUPPORTED;
+  } else
 	switch( ioreq->ios2_Req.io_Command ) {
   case CMD_READ:
     if (ioreq->ios2_BufferManagement == NULL) {
@@ -395,11 +606,26 @@ __saveds VOID DevBeginIO( ASMR(a1) struct IOSana2Req *ioreq       ASMREG(a1),
       ioreq->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
       ioreq->ios2_WireError = S2WERR_UNIT_OFFLINE;
     } else {
+      struct HeldFrame* held;
+      UBYTE quick = ioreq->ios2_Req.io_Flags & SANA2IOF_QUICK;
       ioreq->ios2_Req.io_Flags &= ~SANA2IOF_QUICK;
       ObtainSemaphore(&db->db_ReadListSem);
-      AddTail((struct List*)&db->db_ReadList, (struct Node*)ioreq);
+      queue = find_read_queue(db, ioreq->ios2_PacketType, TRUE);
+      // Kept frames the stack's filter turns down go straight back to the pool
+      while ((queue) && (held = (struct HeldFrame*)RemHead(&queue->rq_Held)) && (!filter_frame(db, ioreq, held->hf_Frame)))
+        AddTail(&db->db_RxPoolFree, (struct Node*)held);
+      if (!queue) held = NULL;
+      if (!held) AddTail(queue ? &queue->rq_Requests : (struct List*)&db->db_ReadList, (struct Node*)ioreq);
       ReleaseSemaphore(&db->db_ReadListSem);
-      ioreq = NULL;
+      if (held) {
+        // A frame was kept for it, so it's answered here, without waiting for frame_proc
+        read_frame(db, ioreq, held->hf_Frame, ((USHORT)held->hf_Frame[0]<<8) + held->hf_Frame[1] + 6);
+        ioreq->ios2_Req.io_Flags |= quick;
+        SCSIWifi_addTime(&db->db_ReadTimes, eclock_now(db) - held->hf_Arrived);
+        ObtainSemaphore(&db->db_ReadListSem);
+        AddTail(&db->db_RxPoolFree, (struct Node*)held);
+        ReleaseSemaphore(&db->db_ReadListSem);
+      } else ioreq = NULL;
     }
     break;
 
@@ -428,6 +654,7 @@ __saveds VOID DevBeginIO( ASMR(a1) struct IOSana2Req *ioreq       ASMREG(a1),
       ioreq->ios2_Req.io_Flags &= ~SANA2IOF_QUICK;
       ioreq->ios2_Req.io_Error = 0;
       ObtainSemaphore(&db->db_WriteListSem);
+      stamp_write(db, ioreq);
       // The sending process reads from the head of the list,
       // so add to the tail here, otherwise packets could go out
       // in swapped order
@@ -512,13 +739,166 @@ __saveds VOID DevBeginIO( ASMR(a1) struct IOSana2Req *ioreq       ASMREG(a1),
       devquery->SizeSupplied = (devquery->SizeAvailable<34?devquery->SizeAvailable:34);
     }
     break;
+  case S2_TRACKTYPE:
+    ObtainSemaphore(&db->db_TypeStatsSem);
+    tracked = find_tracked_type(db, ioreq->ios2_PacketType);
+    if (tracked) tracked->tt_Users++; else {
+      // Reuse a slot whose type is no longer tracked, or take a new one
+      USHORT slot = (USHORT)(ioreq->ios2_PacketType ^ (ioreq->ios2_PacketType >> 4) ^ (ioreq->ios2_PacketType >> 8)) & (TRACK_TYPE_SLOTS-1);
+      for (USHORT i=0; i<TRACK_TYPE_SLOTS; i++) {
+        if ((!db->db_TypeStats[slot].tt_Used) || (!db->db_TypeStats[slot].tt_Users)) {
+          tracked = &db->db_TypeStats[slot];
+          break;
+        }
+        slot = (slot + 1) & (TRACK_TYPE_SLOTS-1);
+      }
+      if (tracked) {
+        memset(&tracked->tt_Stats, 0, sizeof(struct Sana2PacketTypeStats));
+        tracked->tt_PacketType = ioreq->ios2_PacketType;
+        tracked->tt_Used = 1;
+        tracked->tt_Users = 1;
+        db->db_TrackedTypes++;
+      } else {
+        ioreq->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+        ioreq->ios2_WireError = S2WERR_GENERIC_ERROR;
+      }
+    }
+    ReleaseSemaphore(&db->db_TypeStatsSem);
+    break;
+
+  case S2_UNTRACKTYPE:
+    ObtainSemaphore(&db->db_TypeStatsSem);
+    tracked = find_tracked_type(db, ioreq->ios2_PacketType);
+    if (tracked) {
+      // The slot stays Used so types that probed past it can still be found
+      if (!--tracked->tt_Users) db->db_TrackedTypes--;
+    } else {
+      ioreq->ios2_Req.io_Error = S2ERR_BAD_STATE;
+      ioreq->ios2_WireError = S2WERR_NOT_TRACKED;
+    }
+    ReleaseSemaphore(&db->db_TypeStatsSem);
+    break;
+
+  case S2_GETTYPESTATS:
+    ObtainSemaphore(&db->db_TypeStatsSem);
+    tracked = find_tracked_type(db, ioreq->ios2_PacketType);
+    if (tracked) {
+      memcpy(ioreq->ios2_StatData, &tracked->tt_Stats, sizeof(struct Sana2PacketTypeStats));
+    } else {
+      ioreq->ios2_Req.io_Error = S2ERR_BAD_STATE;
+      ioreq->ios2_WireError = S2WERR_NOT_TRACKED;
+    }
+    ReleaseSemaphore(&db->db_TypeStatsSem);
+    break;
+
+#ifdef SCSIDAYNA_TRACE
+  case S2_DAYNA_TRACE:
+    if (!db->db_Trace) {
+      ioreq->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+      break;
+    }
+    if (ioreq->ios2_PacketType & TRACE_CTRL_DUMP) {
+      if (ioreq->ios2_Data) ioreq->ios2_DataLength = Trace_dump(db->db_Trace, ioreq->ios2_Data, ioreq->ios2_DataLength);
+                       else ioreq->ios2_DataLength = 0;
+    }
+    if (ioreq->ios2_PacketType & TRACE_CTRL_CLEAR) db->db_Trace->tr_Next = 0;
+    if (ioreq->ios2_PacketType & TRACE_CTRL_START) db->db_Trace->tr_Enabled = 1;
+    if (ioreq->ios2_PacketType & TRACE_CTRL_STOP) db->db_Trace->tr_Enabled = 0;
+    break;
+#endif
+
   case S2_GETSPECIALSTATS:
     {
       struct Sana2SpecialStatHeader *s2ssh = (struct Sana2SpecialStatHeader *)ioreq->ios2_StatData;
+      struct SCSIWifi_Histogram* histograms[shCount] = {&db->db_CommandTimes.commands[swccRead], &db->db_CommandTimes.commands[swccWrite],
+                                                        &db->db_CommandTimes.commands[swccOther], &db->db_WriteTimes, &db->db_ReadTimes};
       s2ssh->RecordCountSupplied = 0;
+      add_special(s2ssh, S2SS_DAYNA_RXDROPPED, db->db_RxDropped, "Frames nobody was reading");
+      add_special(s2ssh, S2SS_DAYNA_TXDROPPED, db->db_TxDropped, "Frames that couldn't be sent");
+      add_special(s2ssh, S2SS_DAYNA_RSSI, (LONG)db->db_Rssi, "Signal strength (dBm)");
+      add_special(s2ssh, S2SS_DAYNA_CHANNEL, db->db_Channel, "WiFi channel");
+      add_special(s2ssh, S2SS_DAYNA_ECLOCK, db->db_EClockRate, "EClock ticks per second");
+      add_special(s2ssh, S2SS_DAYNA_RXFILTERED, db->db_RxFiltered, "Frames the packet filter rejected");
+      add_special(s2ssh, S2SS_DAYNA_MCASTDROPPED, db->db_MulticastDropped, "Multicasts nobody added");
+      add_special(s2ssh, S2SS_DAYNA_NOTOURS, db->db_RxNotOurs, "Frames for other stations");
+      add_special(s2ssh, S2SS_DAYNA_PROMISCUOUS, db->db_RxPromiscuous, "Frames only wanted in promiscuous mode");
+      add_special(s2ssh, S2SS_DAYNA_LINKCHECKS, db->db_LinkChecks, "Link status checks");
+      for (USHORT i=0; (i<RSSI_HISTORY) && (i<db->db_LinkChecks); i++)
+        add_special(s2ssh, S2SS_DAYNA_RSSI_HISTORY(i), (LONG)db->db_RssiHistory[(db->db_LinkChecks - 1 - i) % RSSI_HISTORY], rssi_history_names[i]);
+      for (USHORT h=0; h<shCount; h++)
+        for (USHORT b=0; b<SCSIWIFI_HISTOGRAM_BUCKETS; b++)
+          add_special(s2ssh, S2SS_DAYNA_HISTOGRAM(h, b), histograms[h]->buckets[b], histogram_names[h][b]);
     }
     break;
-  // Todo: Add S2_ADDMULTICASTADDRESS
+
+  case S2_GETEXTENDEDGLOBALSTATS:
+    {
+      struct Sana2ExtDeviceStats *ext = (struct Sana2ExtDeviceStats *)ioreq->ios2_StatData;
+      struct Sana2ExtDeviceStats stats;
+      ULONG size;
+
+      // The caller says how much room it has, older callers may know fewer fields
+      if ((!ext) || (ext->s2xds_Length < 8)) {
+        ioreq->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        ioreq->ios2_WireError = S2WERR_BAD_STATDATA;
+        break;
+      }
+      size = ext->s2xds_Length < sizeof(stats) ? ext->s2xds_Length : sizeof(stats);
+      memset(&stats, 0, sizeof(stats));
+      stats.s2xds_Length = ext->s2xds_Length;
+      stats.s2xds_Actual = size;
+      stats.s2xds_PacketsReceived.s2q_Low = db->db_DevStats.PacketsReceived;
+      stats.s2xds_PacketsSent.s2q_Low = db->db_DevStats.PacketsSent;
+      stats.s2xds_BadData.s2q_Low = db->db_DevStats.BadData;
+      stats.s2xds_Overruns.s2q_Low = db->db_DevStats.Overruns;
+      stats.s2xds_UnknownTypesReceived.s2q_Low = db->db_DevStats.UnknownTypesReceived;
+      stats.s2xds_Reconfigurations.s2q_Low = db->db_DevStats.Reconfigurations;
+      stats.s2xds_LastStart = db->db_DevStats.LastStart;
+      stats.s2xds_LastConnected = db->db_LastConnected;
+      stats.s2xds_LastDisconnected = db->db_LastDisconnected;
+      stats.s2xds_TimeConnected = db->db_TimeConnected;
+      memcpy(ext, &stats, size);
+    }
+    break;
+
+  case S2_SAMPLE_THROUGHPUT:
+    {
+      struct Sana2ThroughputStats *sample = (struct Sana2ThroughputStats *)ioreq->ios2_StatData;
+      if ((!sample) || (sample->s2ts_Length < sizeof(struct Sana2ThroughputStats))) {
+        ioreq->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        ioreq->ios2_WireError = S2WERR_BAD_STATDATA;
+        break;
+      }
+      // Counts from frame_proc's last update, it adds what's moved since then at the next one.
+      // The request stays queued, updated up to 10 times a second, until it's aborted
+      sample->s2ts_Actual = sizeof(struct Sana2ThroughputStats);
+      ObtainSemaphore(&db->db_SampleListSem);
+      sample->s2ts_StartTime = sample->s2ts_EndTime = db->db_SampleTime;
+      sample->s2ts_BytesSent.s2q_High = sample->s2ts_BytesSent.s2q_Low = 0;
+      sample->s2ts_BytesReceived.s2q_High = sample->s2ts_BytesReceived.s2q_Low = 0;
+      sample->s2ts_Updates.s2q_High = sample->s2ts_Updates.s2q_Low = 0;
+      ioreq->ios2_Req.io_Flags &= ~SANA2IOF_QUICK;
+      AddTail((struct List*)&db->db_SampleList, (struct Node*)ioreq);
+      ReleaseSemaphore(&db->db_SampleListSem);
+      ioreq = NULL;
+    }
+    break;
+  case S2_ADDMULTICASTADDRESS:
+  case S2_DELMULTICASTADDRESS:
+  case S2_ADDMULTICASTADDRESSES:
+  case S2_DELMULTICASTADDRESSES:
+    {
+      // The single address commands are a range of one
+      BOOL add = (ioreq->ios2_Req.io_Command == S2_ADDMULTICASTADDRESS) || (ioreq->ios2_Req.io_Command == S2_ADDMULTICASTADDRESSES);
+      BOOL range = (ioreq->ios2_Req.io_Command == S2_ADDMULTICASTADDRESSES) || (ioreq->ios2_Req.io_Command == S2_DELMULTICASTADDRESSES);
+      BYTE error = change_multicasts(db, ioreq->ios2_SrcAddr, range ? ioreq->ios2_DstAddr : ioreq->ios2_SrcAddr, add);
+      if (error) {
+        ioreq->ios2_Req.io_Error = error;
+        ioreq->ios2_WireError = (error == S2ERR_NO_RESOURCES) ? S2WERR_MULTICAST_FULL : S2WERR_BAD_MULTICAST;
+      } else if ((add) && (db->db_Proc)) Signal((struct Task*)db->db_Proc, SIGBREAKF_CTRL_F);
+    }
+    break;
+
   default:
     {
       ioreq->ios2_Req.io_Error = S2ERR_NOT_SUPPORTED;
@@ -548,6 +928,7 @@ void DoEvent(DEVBASEP, long event)
       if (ior->ios2_WireError & event)
       {
          Remove((struct Node*)ior);
+         ior->ios2_WireError &= event;
          DevTermIO(db, (struct IORequest *)ior);
       }
    }
@@ -555,27 +936,81 @@ void DoEvent(DEVBASEP, long event)
    ReleaseSemaphore(&db->db_EventListSem );
 }
 
+// Removes ioreq from list if it's on it
+BOOL remove_request(struct List* list, struct IORequest* ioreq)
+{
+  struct Node* node;
+  for (node = list->lh_Head; node->ln_Succ; node = node->ln_Succ) {
+    if (node == (struct Node*)ioreq) {
+      Remove(node);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 __saveds LONG DevAbortIO( ASMR(a1) struct IORequest *ioreq        ASMREG(a1),
                             ASMR(a6) DEVBASEP                       ASMREG(a6) )
 {
-	LONG   ret = 0;
+  BOOL   found = FALSE;
   struct IOSana2Req* ios2 = (struct IOSana2Req*)ioreq;
+  struct ReadTypeQueue* queue;
+
+	D(("scsidayna: AbortIO on %lx\n",(ULONG)(IPTR)ioreq));
+
+  // Only requests still waiting on one of our lists can be aborted
+  switch (ioreq->io_Command) {
+    case CMD_READ:
+      ObtainSemaphore(&db->db_ReadListSem);
+      queue = find_read_queue(db, ios2->ios2_PacketType, FALSE);
+      if (queue) found = remove_request(&queue->rq_Requests, ioreq);
+      if (!found) found = remove_request((struct List*)&db->db_ReadList, ioreq);
+      ReleaseSemaphore(&db->db_ReadListSem);
+      break;
 
-	D(("scsidayna: AbortIO on %lx\n",(ULONG)ioreq));
+    case S2_READORPHAN:
+      ObtainSemaphore(&db->db_ReadOrphanListSem);
+      found = remove_request((struct List*)&db->db_ReadOrphanList, ioreq);
+      ReleaseSemaphore(&db->db_ReadOrphanListSem);
+      break;
+
+    case CMD_WRITE:
+    case S2_BROADCAST:
+      ObtainSemaphore(&db->db_WriteListSem);
+      found = remove_request((struct List*)&db->db_WriteList, ioreq);
+      if (found) unstamp_write(db, (struct IOSana2Req*)ioreq, NULL);
+      ReleaseSemaphore(&db->db_WriteListSem);
+      break;
 
-  Remove((struct Node*)ioreq);
+    case S2_ONEVENT:
+      ObtainSemaphore(&db->db_EventListSem);
+      found = remove_request((struct List*)&db->db_EventList, ioreq);
+      ReleaseSemaphore(&db->db_EventListSem);
+      break;
+
+    case S2_SAMPLE_THROUGHPUT:
+      ObtainSemaphore(&db->db_SampleListSem);
+      found = remove_request((struct List*)&db->db_SampleList, ioreq);
+      ReleaseSemaphore(&db->db_SampleListSem);
+      break;
+  }
+
+  // Already finished, or being worked on
+  if (!found) return IOERR_NOCMD;
 
 	ioreq->io_Error = IOERR_ABORTED;
   ios2->ios2_WireError = 0;
 
 	ReplyMsg((struct Message*)ioreq);
-	return ret;
+	return 0;
 }
 
 void DevTermIO( DEVBASEP, struct IORequest *ioreq )
 {
   struct IOSana2Req* ios2 = (struct IOSana2Req*)ioreq;
 
+  TRACE(db->db_Trace, teTermIO, ioreq->io_Command, ioreq);
+
   if (!(ios2->ios2_Req.io_Flags & SANA2IOF_QUICK)) {
     ReplyMsg((struct Message *)ioreq);
   } else {
@@ -584,53 +1019,259 @@ void DevTermIO( DEVBASEP, struct IORequest *ioreq )
 }
 
 
-ULONG write_frame(struct IOSana2Req *req, UBYTE* frame, SCSIWIFIDevice scsiDevice, DEVBASEP)
+// Adds n to a 64 bit counter
+static inline void add_quad(S2QUAD* quad, ULONG n)
+{
+  quad->s2q_Low += n;
+  if (quad->s2q_Low < n) quad->s2q_High++;
+}
+
+// The fastest of the stack's copy functions that our end of the copy is aligned well enough for
+static inline BMFunc pick_copy(BMFunc any, BMFunc copy16, BMFunc copy32, APTR ours)
+{
+  if ((copy32) && (!((IPTR)ours & 3))) return copy32;
+  if ((copy16) && (!((IPTR)ours & 1))) return copy16;
+  return any;
+}
+
+// The stack's own buffer holding req's data, if it offered S2_DMACopyFromBuff32 and has one for this request
+APTR dma_source(struct IOSana2Req *req)
+{
+  struct BufferManagement *bm = (struct BufferManagement *)req->ios2_BufferManagement;
+  if (!bm->bm_DMACopyFromBuffer32) return NULL;
+  return (*bm->bm_DMACopyFromBuffer32)(req->ios2_Data);
+}
+
+// Builds the ethernet frame for req at frame.  Returns its size, or 0 if the data couldn't be copied
+USHORT build_frame(struct IOSana2Req *req, UBYTE* frame, DEVBASEP)
 {
-   ULONG rc=0;
    struct BufferManagement *bm;
+   APTR source;
    USHORT sz=0;
-   UBYTE* inputFrame = frame;
 
    if (req->ios2_Req.io_Flags & SANA2IOF_RAW) {
       sz = req->ios2_DataLength;
    } else {
       sz = req->ios2_DataLength + HW_ETH_HDR_SIZE;
-      *((USHORT*)(frame+6+6)) = (USHORT)req->ios2_PacketType;
       memcpy(frame, req->ios2_DstAddr, HW_ADDRFIELDSIZE);
       memcpy(frame+6, HW_MAC, HW_ADDRFIELDSIZE);
+      frame[12] = (UBYTE)(req->ios2_PacketType >> 8);
+      frame[13] = (UBYTE)(req->ios2_PacketType & 0xFF);
       frame+=HW_ETH_HDR_SIZE;
    }
 
    if (sz>0) {
      bm = (struct BufferManagement *)req->ios2_BufferManagement;
     
-     if (!(*bm->bm_CopyFromBuffer)(frame, req->ios2_Data, req->ios2_DataLength)) {
-       rc = 0; 
+     TRACE(db->db_Trace, teWriteCopy, req->ios2_DataLength, req);
+     // Even with the stack's buffer at hand the data is copied, as the header has to go in front of it
+     if ((source = dma_source(req))) memcpy(frame, source, req->ios2_DataLength);
+     else if (!(*pick_copy(bm->bm_CopyFromBuffer, bm->bm_CopyFromBuffer16, bm->bm_CopyFromBuffer32, frame))(frame, req->ios2_Data, req->ios2_DataLength)) {
        req->ios2_Req.io_Error = S2ERR_SOFTWARE;
        req->ios2_WireError = S2WERR_BUFF_ERROR;
        DoEvent(db, S2EVENT_ERROR | S2EVENT_BUFF | S2EVENT_SOFTWARE);
        D(("bm_CopyFromBuffer FAIL"));
+       return 0;
      }
-     else {
-       // buffer was  
-       if (SCSIWifi_sendFrame(scsiDevice, inputFrame, sz)) {
-         rc = 1;
-         //if (req->ios2_Req.io_Flags & SANA2IOF_RAW) D(("FRAME RAW SENT %ld bytes", sz)); else D(("FRAME SENT %ld bytes", sz));
-         req->ios2_Req.io_Error = req->ios2_WireError = 0;
+     TRACE(db->db_Trace, teWriteCopied, sz, req);
+   } else {
+    D(("no size"));
+   }
+
+   return sz;
+}
+
+ULONG write_frame(struct IOSana2Req *req, UBYTE* frame, SCSIWIFIDevice scsiDevice, DEVBASEP)
+{
+   ULONG rc=0;
+   USHORT sz;
+   UBYTE* direct = ((req->ios2_Req.io_Flags & SANA2IOF_RAW) && (req->ios2_DataLength)) ? (UBYTE*)dma_source(req) : NULL;
+
+   // A raw frame the stack can hand over goes to the DaynaPORT straight from its buffer
+   if (direct) {
+     frame = direct;
+     sz = req->ios2_DataLength;
+     TRACE(db->db_Trace, teWriteCopied, sz, req);
+   } else {
+     // A cooked frame is built 2 bytes in, so the data after its 14 byte header is long aligned
+     if (!(req->ios2_Req.io_Flags & SANA2IOF_RAW)) frame += 2;
+     sz = build_frame(req, frame, db);
+   }
+
+   if (!sz) db->db_TxDropped++; else {
+     db->db_TxCommands++;
+     db->db_TxBatchFrames[1]++;
+     if (SCSIWifi_sendFrame(scsiDevice, frame, sz)) {
+       rc = 1;
+       //if (req->ios2_Req.io_Flags & SANA2IOF_RAW) D(("FRAME RAW SENT %ld bytes", sz)); else D(("FRAME SENT %ld bytes", sz));
+       req->ios2_Req.io_Error = req->ios2_WireError = 0;
+       db->db_DevStats.PacketsSent++;
+       add_quad(&db->db_BytesSent, sz);
+       count_type(db, frame, sz, TRUE, FALSE);
+     } else {
+       rc = 0;  
+       db->db_TxDropped++;
+       req->ios2_Req.io_Error = S2ERR_TX_FAILURE;
+       req->ios2_WireError = S2WERR_GENERIC_ERROR;
+       DoEvent(db, S2EVENT_ERROR | S2EVENT_TX | S2EVENT_HARDWARE);
+       D(("SEND FAIL"));
+     }
+   }
+
+   return rc;
+}
+
+// Notes when ior was queued, with db_WriteListSem held
+void stamp_write(DEVBASEP, struct IOSana2Req *ior)
+{
+  for (USHORT i=0; i<WRITE_STAMP_SLOTS; i++)
+    if (!db->db_WriteStamps[i].ws_Request) {
+      db->db_WriteStamps[i].ws_Request = ior;
+      db->db_WriteStamps[i].ws_Queued = eclock_now(db);
+      return;
+    }
+}
+
+// Frees ior's stamp, with db_WriteListSem held.  Returns TRUE, and when it was queued, if it had one
+BOOL unstamp_write(DEVBASEP, struct IOSana2Req *ior, ULONG* queued)
+{
+  for (USHORT i=0; i<WRITE_STAMP_SLOTS; i++)
+    if (db->db_WriteStamps[i].ws_Request == ior) {
+      db->db_WriteStamps[i].ws_Request = NULL;
+      if (queued) *queued = db->db_WriteStamps[i].ws_Queued;
+      return TRUE;
+    }
+  return FALSE;
+}
+
+// Sends up to SCSIWIFI_TX_BATCH_MAX queued writes.  If the firmware can take several frames
+// in one WRITE FRAME they're packed into buffer (bufferSize bytes) and sent together, otherwise one at a time.
+// Returns how many requests were completed
+USHORT write_frames(UBYTE* buffer, ULONG bufferSize, SCSIWIFIDevice scsiDevice, DEVBASEP)
+{
+   struct IOSana2Req *ior, *nextwrite;
+   struct IOSana2Req *batch[SCSIWIFI_TX_BATCH_MAX];
+   UBYTE* headers[SCSIWIFI_TX_BATCH_MAX];
+   UBYTE* built[SCSIWIFI_TX_BATCH_MAX];
+   ULONG queued[SCSIWIFI_TX_BATCH_MAX];
+   BOOL stamped[SCSIWIFI_TX_BATCH_MAX];
+   USHORT count = 0, frames = 0, i;
+   ULONG pos = 0, now;
+
+   if (!SCSIWifi_canBatchWrites(scsiDevice)) {
+     ObtainSemaphore(&db->db_WriteListSem);
+     for(ior = (struct IOSana2Req *)db->db_WriteList.lh_Head; (nextwrite = (struct IOSana2Req *) ior->ios2_Req.io_Message.mn_Node.ln_Succ) != NULL; ior = nextwrite ) {
+         write_frame(ior, buffer, scsiDevice, db);
+         Remove((struct Node*)ior);
+         if (unstamp_write(db, ior, &queued[0])) SCSIWifi_addTime(&db->db_WriteTimes, eclock_now(db) - queued[0]);
+         DevTermIO(db, (struct IORequest *)ior);
+         if (++count == SCSIWIFI_TX_BATCH_MAX) break;
+     }
+     ReleaseSemaphore(&db->db_WriteListSem);
+     return count;
+   }
+
+   // Take the requests off the list first so the list isn't held while the data is copied and sent
+   ObtainSemaphore(&db->db_WriteListSem);
+   for(ior = (struct IOSana2Req *)db->db_WriteList.lh_Head; (nextwrite = (struct IOSana2Req *) ior->ios2_Req.io_Message.mn_Node.ln_Succ) != NULL; ior = nextwrite ) {
+       ULONG sz = ior->ios2_DataLength + SCSIWIFI_SEND_HEADER_SIZE;
+       if (!(ior->ios2_Req.io_Flags & SANA2IOF_RAW)) sz += HW_ETH_HDR_SIZE;
+       if ((count) && (pos + sz > bufferSize - 2)) break;      // see below for the 2
+       Remove((struct Node*)ior);
+       stamped[count] = unstamp_write(db, ior, &queued[count]);
+       batch[count++] = ior;
+       pos += (sz + 1) & ~1;
+       if (count == SCSIWIFI_TX_BATCH_MAX) break;
+   }
+   ReleaseSemaphore(&db->db_WriteListSem);
+
+   // A lone frame goes as a plain WRITE FRAME, which for a raw one may not need copying at all
+   if (count == 1) {
+     write_frame(batch[0], buffer, scsiDevice, db);
+     if (stamped[0]) SCSIWifi_addTime(&db->db_WriteTimes, eclock_now(db) - queued[0]);
+     DevTermIO(db, (struct IORequest *)batch[0]);
+     return 1;
+   }
+
+   // Build the frames, each with its header.  Starting 2 bytes in puts the data of the first
+   // cooked frame, after its 4 byte record header and 14 byte ethernet header, on a long boundary
+   buffer += 2;
+   pos = 0;
+   for (i=0; i<count; i++) {
+     UBYTE* header = buffer + pos;
+     USHORT sz = build_frame(batch[i], header + SCSIWIFI_SEND_HEADER_SIZE, db);
+     built[i] = sz ? header : NULL;
+     if (!sz) {             // error already set
+       db->db_TxDropped++;
+       continue;
+     }
+     header[0] = (UBYTE)(sz >> 8);
+     header[1] = (UBYTE)(sz & 0xFF);
+     header[2] = header[3] = 0;
+     if (frames) headers[frames-1][2] = SCSIWIFI_FLAG_RECORD_FOLLOWS;
+     headers[frames++] = header;
+     pos += (SCSIWIFI_SEND_HEADER_SIZE + sz + 1) & ~1;
+   }
+
+   if (frames) {
+     ULONG ok;
+     // A single frame goes as a plain WRITE FRAME
+     if (frames == 1) ok = SCSIWifi_sendFrame(scsiDevice, headers[0] + SCSIWIFI_SEND_HEADER_SIZE, ((USHORT)headers[0][0]<<8) | headers[0][1]);
+                 else ok = SCSIWifi_sendFrames(scsiDevice, buffer, pos);
+     db->db_TxCommands++;
+     db->db_TxBatchFrames[frames]++;
+
+     for (i=0; i<count; i++) {
+       if (!built[i]) continue;
+       if (ok) {
+         batch[i]->ios2_Req.io_Error = batch[i]->ios2_WireError = 0;
          db->db_DevStats.PacketsSent++;
+         add_quad(&db->db_BytesSent, ((USHORT)built[i][0]<<8) | built[i][1]);
+         count_type(db, built[i] + SCSIWIFI_SEND_HEADER_SIZE, ((USHORT)built[i][0]<<8) | built[i][1], TRUE, FALSE);
        } else {
-         rc = 0;  
-         req->ios2_Req.io_Error = S2ERR_TX_FAILURE;
-         req->ios2_WireError = S2WERR_GENERIC_ERROR;
-         DoEvent(db, S2EVENT_ERROR | S2EVENT_TX | S2EVENT_HARDWARE);
-         D(("SEND FAIL"));
+         db->db_TxDropped++;
+         batch[i]->ios2_Req.io_Error = S2ERR_TX_FAILURE;
+         batch[i]->ios2_WireError = S2WERR_GENERIC_ERROR;
        }
      }
-   } else {
-    D(("no size"));
+     if (!ok) {
+       DoEvent(db, S2EVENT_ERROR | S2EVENT_TX | S2EVENT_HARDWARE);
+       D(("SEND FAIL"));
+     }
    }
 
-   return rc;
+   now = eclock_now(db);
+   for (i=0; i<count; i++) {
+     if (stamped[i]) SCSIWifi_addTime(&db->db_WriteTimes, now - queued[i]);
+     DevTermIO(db, (struct IORequest *)batch[i]);
+   }
+   return count;
+}
+
+// Asks the stack's S2_PacketFilter hook, if it gave one, whether req wants the frame at frm (as read,
+// record header first).  The hook sees the frame where it is, before anything is copied
+BOOL filter_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm)
+{
+  struct BufferManagement *bm = (struct BufferManagement *)req->ios2_BufferManagement;
+  ULONG sz = ((ULONG)frm[0]<<8)|((ULONG)frm[1]);
+  UBYTE* data = frm+6;
+
+  if ((!bm->bm_PacketFilter) || (sz < 4 + HW_ETH_HDR_SIZE)) return TRUE;
+
+  // The hook gets the request filled in as it would be if the frame were accepted
+  sz -= 4;
+  if (!(req->ios2_Req.io_Flags & SANA2IOF_RAW)) {
+    data += HW_ETH_HDR_SIZE;
+    sz -= HW_ETH_HDR_SIZE;
+  }
+  req->ios2_PacketType = ((USHORT)frm[12+6]<<8)|((USHORT)frm[13+6]);
+  req->ios2_DataLength = sz;
+  memcpy(req->ios2_SrcAddr, frm+6+6, HW_ADDRFIELDSIZE);
+  memcpy(req->ios2_DstAddr, frm+6, HW_ADDRFIELDSIZE);
+  if (CallHookPkt(bm->bm_PacketFilter, req, data)) return TRUE;
+
+  db->db_RxFiltered++;
+  return FALSE;
 }
 
 ULONG read_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm, USHORT packetSize)
@@ -663,7 +1304,8 @@ ULONG read_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm, USHORT packetSize
 
   // copy frame to device user (probably tcp/ip system)
   bm = (struct BufferManagement *)req->ios2_BufferManagement;
-  if (!(*bm->bm_CopyToBuffer)(req->ios2_Data, frame_ptr, datasize)) {
+  TRACE(db->db_Trace, teReadCopy, datasize, req);
+  if (!(*pick_copy(bm->bm_CopyToBuffer, bm->bm_CopyToBuffer16, bm->bm_CopyToBuffer32, frame_ptr))(req->ios2_Data, frame_ptr, datasize)) {
     req->ios2_Req.io_Error = S2ERR_SOFTWARE;
     req->ios2_WireError = S2WERR_BUFF_ERROR;
     DoEvent(db, S2EVENT_ERROR | S2EVENT_BUFF | S2EVENT_SOFTWARE);
@@ -673,6 +1315,7 @@ ULONG read_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm, USHORT packetSize
     req->ios2_Req.io_Error = req->ios2_WireError = 0;
     res = 1;
   }
+  TRACE(db->db_Trace, teReadCopied, datasize, req);
 
   memcpy(req->ios2_SrcAddr, frm+6+6, HW_ADDRFIELDSIZE);
   memcpy(req->ios2_DstAddr, frm+6, HW_ADDRFIELDSIZE);
@@ -687,41 +1330,330 @@ ULONG read_frame(DEVBASEP, struct IOSana2Req *req, UBYTE *frm, USHORT packetSize
   }
   if (broadcast) {
     req->ios2_Req.io_Flags |= SANA2IOF_BCAST;
+  } else if (frm[6] & 1) {
+    req->ios2_Req.io_Flags |= SANA2IOF_MCAST;
   }
   return res;
 }
 
 
-void rejectAllPackets(DEVBASEP) {
+// Returns the queue of reads for packetType, creating it if asked and there's room. db_ReadListSem must be held
+struct ReadTypeQueue* find_read_queue(DEVBASEP, ULONG packetType, BOOL create)
+{
+  USHORT slot = (USHORT)(packetType ^ (packetType >> 4) ^ (packetType >> 8)) & (READ_TYPE_SLOTS-1);
+  for (USHORT i=0; i<READ_TYPE_SLOTS; i++) {
+    struct ReadTypeQueue* queue = &db->db_ReadTypes[slot];
+    if (!queue->rq_InUse) {
+      if (!create) return NULL;
+      queue->rq_InUse = 1;
+      queue->rq_PacketType = packetType;
+      return queue;
+    }
+    if (queue->rq_PacketType == packetType) return queue;
+    slot = (slot + 1) & (READ_TYPE_SLOTS-1);
+  }
+  return NULL;
+}
+
+// Puts a CMD_READ taken with take_read() back at the front of its queue
+void return_read(DEVBASEP, struct IOSana2Req *ior)
+{
+  struct ReadTypeQueue* queue;
+
+  ObtainSemaphore(&db->db_ReadListSem);
+  queue = find_read_queue(db, ior->ios2_PacketType, FALSE);
+  AddHead(queue ? &queue->rq_Requests : (struct List*)&db->db_ReadList, (struct Node*)ior);
+  ReleaseSemaphore(&db->db_ReadListSem);
+}
+
+// Frees the frame that's been in the receive pool longest, if that's over RX_POOL_MAX_AGE. db_ReadListSem must be held
+struct HeldFrame* reclaim_held(DEVBASEP, ULONG now)
+{
+  struct HeldFrame *held, *oldest = NULL;
+  ULONG oldestAge = db->db_EClockRate * RX_POOL_MAX_AGE;
+
+  for (USHORT i=0; i<READ_TYPE_SLOTS; i++) {
+    if (!db->db_ReadTypes[i].rq_InUse) continue;
+    held = (struct HeldFrame*)db->db_ReadTypes[i].rq_Held.lh_Head;
+    if ((held->hf_Node.mln_Succ) && (now - held->hf_Arrived > oldestAge)) {
+      oldest = held;
+      oldestAge = now - held->hf_Arrived;
+    }
+  }
+  if (oldest) {
+    Remove((struct Node*)oldest);
+    db->db_RxDropped++;
+  }
+  return oldest;
+}
+
+// Takes the next CMD_READ for packetType.  If there isn't one, but there have been, the frame (as read,
+// record header first) is kept in the receive pool for the next one and *held is set. Otherwise it's up to the caller
+struct IOSana2Req* take_read(DEVBASEP, ULONG packetType, UBYTE* frame, ULONG arrived, BOOL* held)
+{
+  struct IOSana2Req *ior = NULL, *next;
+  struct ReadTypeQueue* queue;
+  struct HeldFrame* keep;
+  USHORT frameSize;
+
+  *held = FALSE;
+  ObtainSemaphore(&db->db_ReadListSem);
+  queue = find_read_queue(db, packetType, FALSE);
+  if (queue) {
+    ior = (struct IOSana2Req *)RemHead(&queue->rq_Requests);
+    frameSize = ((USHORT)frame[0]<<8)|((USHORT)frame[1]);
+    if ((!ior) && (db->db_RxPool) && (frameSize <= SCSIWIFI_PACKET_MAX_SIZE)) {
+      if ((keep = (struct HeldFrame*)RemHead(&db->db_RxPoolFree)) || (keep = reclaim_held(db, arrived))) {
+        memcpy(keep->hf_Frame, frame, frameSize + 6);
+        keep->hf_Arrived = arrived;
+        AddTail(&queue->rq_Held, (struct Node*)keep);
+        *held = TRUE;
+      } else db->db_DevStats.Overruns++;
+    }
+  }
+  if (!ior) {
+    // Types that didn't fit in the table
+    for (next = (struct IOSana2Req *)db->db_ReadList.lh_Head; next->ios2_Req.io_Message.mn_Node.ln_Succ; next = (struct IOSana2Req *)next->ios2_Req.io_Message.mn_Node.ln_Succ) {
+      if (next->ios2_PacketType == packetType) {
+        Remove((struct Node*)next);
+        ior = next;
+        break;
+      }
+    }
+  }
+  ReleaseSemaphore(&db->db_ReadListSem);
+  return ior;
+}
+
+// Returns the table entry for a multicast address, or NULL if it isn't there. db_MulticastSem must be held
+struct MulticastAddress* find_multicast(DEVBASEP, UBYTE* address)
+{
+  USHORT slot = (USHORT)(address[3] ^ address[4] ^ address[5]) & (MULTICAST_SLOTS-1);
+  for (USHORT i=0; i<MULTICAST_SLOTS; i++) {
+    struct MulticastAddress* entry = &db->db_MulticastTable[slot];
+    if (!entry->ma_Used) return NULL;
+    if ((entry->ma_Users) && (memcmp(entry->ma_Address, address, HW_ADDRFIELDSIZE) == 0)) return entry;
+    slot = (slot + 1) & (MULTICAST_SLOTS-1);
+  }
+  return NULL;
+}
+
+// Adds (or removes) a user of each multicast address from low to high inclusive.  Returns 0, or the
+// io_Error: S2ERR_BAD_ADDRESS if they aren't multicasts or one being removed isn't there, S2ERR_NO_RESOURCES if the table's full.
+// On an error nothing is changed
+BYTE change_multicasts(DEVBASEP, UBYTE* low, UBYTE* high, BOOL add)
+{
+  UBYTE address[HW_ADDRFIELDSIZE];
+  USHORT count = 0, i, j;
+  BYTE error = 0;
+  struct MulticastAddress* entry;
+
+  if ((!low) || (!high) || (!(low[0] & 1)) || (memcmp(low, high, HW_ADDRFIELDSIZE) > 0)) return S2ERR_BAD_ADDRESS;
+
+  ObtainSemaphore(&db->db_MulticastSem);
+  memcpy(address, low, HW_ADDRFIELDSIZE);
+  for (;;) {
+    entry = find_multicast(db, address);
+    if (add) {
+      if (!entry) {
+        // Reuse a slot whose address is no longer wanted, or take a new one
+        USHORT slot = (USHORT)(address[3] ^ address[4] ^ address[5]) & (MULTICAST_SLOTS-1);
+        for (i=0; i<MULTICAST_SLOTS; i++) {
+          if ((!db->db_MulticastTable[slot].ma_Used) || (!db->db_MulticastTable[slot].ma_Users)) {
+            entry = &db->db_MulticastTable[slot];
+            break;
+          }
+          slot = (slot + 1) & (MULTICAST_SLOTS-1);
+        }
+        if (!entry) {
+          error = S2ERR_NO_RESOURCES;
+          break;
+        }
+        memcpy(entry->ma_Address, address, HW_ADDRFIELDSIZE);
+        entry->ma_Used = 1;
+        db->db_Multicasts++;
+        db->db_MulticastsChanged = 1;
+      }
+      entry->ma_Users++;
+    } else {
+      if (!entry) {
+        error = S2ERR_BAD_ADDRESS;
+        break;
+      }
+      // The slot stays Used so addresses that probed past it can still be found
+      if (!--entry->ma_Users) db->db_Multicasts--;
+    }
+    count++;
+    if (memcmp(address, high, HW_ADDRFIELDSIZE) == 0) break;
+    // Next address: a 48 bit increment, a byte at a time
+    for (j=HW_ADDRFIELDSIZE; (j--) && (!++address[j]); );
+  }
+
+  // Undo whatever was done before the error
+  if (error) {
+    memcpy(address, low, HW_ADDRFIELDSIZE);
+    for (i=0; i<count; i++) {
+      entry = find_multicast(db, address);
+      if (add) {
+        if (!--entry->ma_Users) db->db_Multicasts--;
+      } else if (entry) entry->ma_Users++; else {
+        // It went when its last user did, so it's still in the slot it had
+        USHORT slot = (USHORT)(address[3] ^ address[4] ^ address[5]) & (MULTICAST_SLOTS-1);
+        while ((db->db_MulticastTable[slot].ma_Users) || (memcmp(db->db_MulticastTable[slot].ma_Address, address, HW_ADDRFIELDSIZE))) slot = (slot + 1) & (MULTICAST_SLOTS-1);
+        db->db_MulticastTable[slot].ma_Users = 1;
+        db->db_Multicasts++;
+      }
+      for (j=HW_ADDRFIELDSIZE; (j--) && (!++address[j]); );
+    }
+  } else if (add) db->db_MulticastFiltering = 1;
+  ReleaseSemaphore(&db->db_MulticastSem);
+  return error;
+}
+
+// Whether a frame to address should be passed on: anything not multicast, broadcasts, and added multicasts.
+// Until the stack adds one it hasn't said which it wants, so (as before there was a table) they all are
+BOOL multicast_wanted(DEVBASEP, UBYTE* address)
+{
+  BOOL wanted;
+
+  if (!(address[0] & 1)) return TRUE;
+  if (!db->db_MulticastFiltering) return TRUE;
+  if ((address[0] == 0xFF) && (address[1] == 0xFF) && (address[2] == 0xFF) && (address[3] == 0xFF) && (address[4] == 0xFF) && (address[5] == 0xFF)) return TRUE;
+  if (!db->db_Multicasts) return FALSE;
+
+  ObtainSemaphore(&db->db_MulticastSem);
+  wanted = find_multicast(db, address) != NULL;
+  ReleaseSemaphore(&db->db_MulticastSem);
+  return wanted;
+}
+
+// Whether a frame to address should go to the stack: those for us, broadcasts and added multicasts, or
+// in promiscuous mode all of them.  Anything else is counted
+BOOL frame_wanted(DEVBASEP, UBYTE* address)
+{
+  if (address[0] & 1) {
+    if (multicast_wanted(db, address)) return TRUE;
+  } else if ((address[5] == HW_MAC[5]) && (memcmp(address, HW_MAC, HW_ADDRFIELDSIZE) == 0)) return TRUE;    // last byte first, it's the one that differs
+
+  if (db->db_Promiscuous) {
+    db->db_RxPromiscuous++;
+    return TRUE;
+  }
+  if (address[0] & 1) db->db_MulticastDropped++; else db->db_RxNotOurs++;
+  return FALSE;
+}
+
+// Tells the DaynaPORT about every address in the multicast table.  It can't be told to forget one,
+// so those that have gone are just filtered out here
+void push_multicasts(DEVBASEP, SCSIWIFIDevice scsiDevice)
+{
+  struct SCSIWifi_MACAddress addresses[MULTICAST_SLOTS];
+  USHORT count = 0;
+
+  ObtainSemaphore(&db->db_MulticastSem);
+  db->db_MulticastsChanged = 0;
+  for (USHORT i=0; i<MULTICAST_SLOTS; i++)
+    if (db->db_MulticastTable[i].ma_Users) memcpy(addresses[count++].address, db->db_MulticastTable[i].ma_Address, HW_ADDRFIELDSIZE);
+  ReleaseSemaphore(&db->db_MulticastSem);
+
+  for (USHORT i=0; i<count; i++)
+    if (!SCSIWifi_addMulticastAddress(scsiDevice, &addresses[i])) D(("scsidayna: multicast address not accepted\n"));
+}
+
+// Returns the tracked type entry for packetType, or NULL if it isn't tracked. db_TypeStatsSem must be held
+struct TrackedType* find_tracked_type(DEVBASEP, ULONG packetType)
+{
+  USHORT slot = (USHORT)(packetType ^ (packetType >> 4) ^ (packetType >> 8)) & (TRACK_TYPE_SLOTS-1);
+  for (USHORT i=0; i<TRACK_TYPE_SLOTS; i++) {
+    struct TrackedType* tracked = &db->db_TypeStats[slot];
+    if (!tracked->tt_Used) return NULL;
+    if ((tracked->tt_Users) && (tracked->tt_PacketType == packetType)) return tracked;
+    slot = (slot + 1) & (TRACK_TYPE_SLOTS-1);
+  }
+  return NULL;
+}
+
+// Adds an ethernet frame (header included, no CRC) to its type's counters if that type is tracked
+void count_type(DEVBASEP, UBYTE* frame, USHORT size, BOOL sent, BOOL dropped)
+{
+  struct TrackedType* tracked;
+
+  // Nothing tracked, which is the usual case, costs just this test
+  if (!db->db_TrackedTypes) return;
+
+  ObtainSemaphore(&db->db_TypeStatsSem);
+  if (tracked = find_tracked_type(db, ((ULONG)frame[12]<<8)|((ULONG)frame[13]))) {
+    if (dropped) tracked->tt_Stats.PacketsDropped++; else
+    if (sent) {
+      tracked->tt_Stats.PacketsSent++;
+      tracked->tt_Stats.BytesSent += size;
+    } else {
+      tracked->tt_Stats.PacketsReceived++;
+      tracked->tt_Stats.BytesReceived += size;
+    }
+  }
+  ReleaseSemaphore(&db->db_TypeStatsSem);
+}
+
+// Brings the S2_SAMPLE_THROUGHPUT requests up to date with what's been sent and received since the last update
+void update_samplers(DEVBASEP, struct timeval* now)
+{
+  struct Node* node;
+  ULONG received = db->db_BytesReceived.s2q_Low - db->db_SampledReceived;
+  ULONG sent = db->db_BytesSent.s2q_Low - db->db_SampledSent;
+
+  ObtainSemaphore(&db->db_SampleListSem);
+  for (node = db->db_SampleList.lh_Head; node->ln_Succ; node = node->ln_Succ) {
+    struct Sana2ThroughputStats *sample = (struct Sana2ThroughputStats *)((struct IOSana2Req*)node)->ios2_StatData;
+    add_quad(&sample->s2ts_BytesReceived, received);
+    add_quad(&sample->s2ts_BytesSent, sent);
+    add_quad(&sample->s2ts_Updates, 1);
+    sample->s2ts_EndTime = *now;
+    if (sample->s2ts_NotifyTask) Signal(sample->s2ts_NotifyTask, sample->s2ts_NotifyMask);
+  }
+  db->db_SampledReceived = db->db_BytesReceived.s2q_Low;
+  db->db_SampledSent = db->db_BytesSent.s2q_Low;
+  db->db_SampleTime = *now;
+  ReleaseSemaphore(&db->db_SampleListSem);
+}
+
+// Hands back everything on list as offline
+void reject_list(DEVBASEP, struct List* list)
+{
+  struct IOSana2Req *ior;
+  while (ior = (struct IOSana2Req *)RemHead(list)) {
+    ior->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
+    ior->ios2_WireError = S2WERR_UNIT_OFFLINE;
+    DevTermIO(db, (struct IORequest*)ior);
+  }
+}
+
+// Hands back everything on list as aborted
+void abort_list(DEVBASEP, struct List* list)
+{
   struct IOSana2Req *ior;
+  while (ior = (struct IOSana2Req *)RemHead(list)) {
+    ior->ios2_Req.io_Error = IOERR_ABORTED;
+    ior->ios2_WireError = 0;
+    DevTermIO(db, (struct IORequest*)ior);
+  }
+}
 
+void rejectAllPackets(DEVBASEP) {
   D(("Reject all Packets\n"));
 
    ObtainSemaphore(&db->db_WriteListSem);
-   for (ior = (struct IOSana2Req *)db->db_WriteList.lh_Head; ior->ios2_Req.io_Message.mn_Node.ln_Succ; ior = (struct IOSana2Req *)ior->ios2_Req.io_Message.mn_Node.ln_Succ) {      
-      ior->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
-      ior->ios2_WireError = S2WERR_UNIT_OFFLINE;
-      Remove((struct Node*)ior);
-      DevTermIO(db, (struct IORequest*)ior);
-   }
+   reject_list(db, (struct List*)&db->db_WriteList);
+   memset(db->db_WriteStamps, 0, sizeof(db->db_WriteStamps));
    ReleaseSemaphore(&db->db_WriteListSem);
 
    ObtainSemaphore(&db->db_ReadListSem);
-   for (ior = (struct IOSana2Req *)db->db_ReadList.lh_Head; ior->ios2_Req.io_Message.mn_Node.ln_Succ; ior = (struct IOSana2Req *)ior->ios2_Req.io_Message.mn_Node.ln_Succ) {
-      ior->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
-      ior->ios2_WireError = S2WERR_UNIT_OFFLINE;
-      Remove((struct Node*)ior);
-      DevTermIO(db, (struct IORequest*)ior);
-   }
+   for (int i=0; i<READ_TYPE_SLOTS; i++) reject_list(db, &db->db_ReadTypes[i].rq_Requests);
+   reject_list(db, (struct List*)&db->db_ReadList);
    ReleaseSemaphore(&db->db_ReadListSem);
 
-  ObtainSemaphore(&db->db_ReadOrphanListSem);
-   for (ior = (struct IOSana2Req *)db->db_ReadOrphanList.lh_Head; ior->ios2_Req.io_Message.mn_Node.ln_Succ; ior = (struct IOSana2Req *)ior->ios2_Req.io_Message.mn_Node.ln_Succ) {
-      ior->ios2_Req.io_Error = S2ERR_OUTOFSERVICE;
-      ior->ios2_WireError = S2WERR_UNIT_OFFLINE;
-      Remove((struct Node*)ior);
-      DevTermIO(db, (struct IORequest*)ior);
-   }
+   ObtainSemaphore(&db->db_ReadOrphanListSem);
+   reject_list(db, (struct List*)&db->db_ReadOrphanList);
    ReleaseSemaphore(&db->db_ReadOrphanListSem);   
 
    D(("Reject all Packets done\n"));
@@ -745,26 +1677,21 @@ __saveds void frame_proc() {
   // This semaphore must be obtained by this process before it replies its init message, and then
   // hold it for its entire lifetime, otherwise the process exit won't be arbitrated properly.
   ObtainSemaphore(&db->db_ProcSem);
+  ObtainSemaphore(&db->db_ActiveSem);
 
-  // Need to open a seperate connection to the SCSI device, This has the advantage that it can communicate at the same time!
-
+  // The SCSI device DevInit opened, with its replies now coming here
   struct ScsiDaynaSettings* settings = (struct ScsiDaynaSettings*)db->db_scsiSettings;
-  struct SCSIDevice_OpenData openData;
-  openData.sysBase = (struct ExecBase*)SysBase;
-  openData.utilityBase = (void*)UtilityBase;
-  openData.dosBase = (void*)DOSBase;
-  openData.deviceDriverName = settings->deviceName;
-  openData.deviceID = db->db_scsiDeviceID;
-  openData.scsiMode = db->db_scsiMode;
+  SCSIWIFIDevice scsiDevice = db->db_ScsiDevice;
+  if ((scsiDevice) && (!SCSIWifi_adopt(scsiDevice))) scsiDevice = NULL;
 
-  D(("Opening with scsimode %ld", openData.scsiMode));
-
-  enum SCSIWifi_OpenResult scsiResult;
-  SCSIWIFIDevice scsiDevice = SCSIWifi_open(&openData, &scsiResult);
-
-  char* packetData = AllocVec(SCSIWIFI_PACKET_MAX_SIZE + 6, MEMF_PUBLIC);
+  // The controller DMAs the batched writes straight out of this, so it goes where it can reach
+  struct SCSIWifi_Transport* transport = SCSIWifi_findTransport((void*)UtilityBase, settings->deviceName);
+  char* packetData = AllocVec(SCSIWIFI_RECEIVE_BUFFER_SIZE, transport->memoryType);
   struct MsgPort timerPort;
+  timerPort.mp_Node.ln_Type = NT_MSGPORT;
   timerPort.mp_Node.ln_Pri = 0;                       
+  timerPort.mp_Node.ln_Name = NULL;
+  timerPort.mp_Flags       = PA_SIGNAL;
   timerPort.mp_SigBit      = AllocSignal(-1);
   timerPort.mp_SigTask     = (struct Task *)FindTask(0);
   NewList(&timerPort.mp_MsgList);
@@ -774,7 +1701,11 @@ __saveds void frame_proc() {
 
   if (((char)timerPort.mp_SigBit)>=0) {
     time_req = (struct timerequest*) CreateIORequest(&timerPort, sizeof (struct timerequest));
-    if (time_req) errorDevOpen = OpenDevice("timer.device", UNIT_VBLANK, (struct IORequest *)time_req, 0);
+    // MICROHZ so the poll rate isn't stuck at the 50Hz VBLANK granularity
+    if (time_req) {
+      errorDevOpen = OpenDevice("timer.device", UNIT_MICROHZ, (struct IORequest *)time_req, 0);
+      if (errorDevOpen != 0) errorDevOpen = OpenDevice("timer.device", UNIT_VBLANK, (struct IORequest *)time_req, 0);
+    }
   }
 
   if ((!scsiDevice) || (!packetData) || (errorDevOpen !=0) || (((char)timerPort.mp_SigBit) < 0) || (!time_req) ) {
@@ -783,16 +1714,12 @@ __saveds void frame_proc() {
     if (!packetData) D(("scsidayna_task: Out of memory [1]\n")); else FreeVec(packetData);
     if (!time_req) D(("scsidayna_task: Out of memory [2]\n")); else DeleteIORequest((struct IORequest *)time_req);
 
-    switch (scsiResult) {
-      case sworOpenDeviceFailed: D(("scsidayna_task: Failed to open SCSI device \"%s\" ID %d\n", settings->deviceName, settings->deviceID)); break;  
-      case sworOutOfMem:  D(("scsidayna_task: Out of memory opening SCSI device\n"));    break;
-      case sworInquireFail:  D(("scsidayna_task: Inquiry of SCSI device failed\n"));    break;
-      case sworNotDaynaDevice:  D(("scsidayna_task: Device is not a DaynaPort SCSI device\n"));    break;
-    }
+    if (!scsiDevice) D(("scsidayna_task: No signal for the SCSI device\n")); else SCSIWifi_release(scsiDevice);
 
     if (((char)timerPort.mp_SigBit)>=0) FreeSignal(timerPort.mp_SigBit);
     ReplyMsg((struct Message*)init);
     Forbid();
+    ReleaseSemaphore(&db->db_ActiveSem);
     ReleaseSemaphore(&db->db_ProcSem);
     D(("scsidayna_task: shutdown\n"));
     return;
@@ -801,6 +1728,21 @@ __saveds void frame_proc() {
   // Helpful!
   struct Library *TimerBase = (APTR) time_req->tr_node.io_Device;
 
+  // Time SCSI commands and requests from here on
+  {
+    struct EClockVal now;
+    db->db_EClockRate = ReadEClock(&now);
+    db->db_TimerBase = TimerBase;
+    SCSIWifi_setTiming(scsiDevice, TimerBase, &db->db_CommandTimes);
+#ifdef SCSIDAYNA_TRACE
+    if (db->db_Trace) {
+      db->db_Trace->tr_EClockRate = db->db_EClockRate;
+      db->db_Trace->tr_TimerBase = TimerBase;
+      SCSIWifi_setTrace(scsiDevice, db->db_Trace);
+    }
+#endif
+  }
+
   init->error = 0;
   ReplyMsg((struct Message*)init);
 
@@ -811,89 +1753,256 @@ __saveds void frame_proc() {
 
   ULONG recv = 0;
   USHORT currentWifiState = 0;
+  UBYTE lingered = 0;     // ended after lingering.  DevOpen may already be setting up the lists for the next one
 
  if (settings->taskPriority != 0)
    SetTaskPri((struct Task*)db->db_Proc,settings->taskPriority);      
 
-  struct timeval timeLastWifiCheck = {0UL,0UL};
   struct timeval timeWifiCheck = {0UL,0UL};
+  ULONG timeLastWifiCheck = 0;              // tv_secs of the last status command
+  struct timeval linkWatch = {0UL,0UL};     // when the traffic was last looked at
+  ULONG linkReceived = 0, linkSent = 0;     // frame counts then
+  UBYTE linkFlowing = 0;                    // frames had arrived in the LINK_WATCH_MICROS before that
+  UBYTE linkSuspect = 1;                    // check at every look: the link's down, or the last check or a receive failed
   USHORT lastWifiStatus = 1;    // assume OK, although this should get overwritten straight away
+  struct timeval txHoldStart = {0UL,0UL};
+  UBYTE txHolding = 0;
+  struct timeval timeConnectedBefore = db->db_TimeConnected;   // up to the last disconnect
+
+  // Polling governor.  While frames are flowing there's no sleep at all.  Once they stop the sleep between
+  // polls doubles from SCSIWIFI_POLL_MIN up to POLLMAX, and drops back as soon as anything happens
+  ULONG pollMicros = SCSIWIFI_POLL_MIN;
+  ULONG pollCeiling = (ULONG)(settings->pollMax ? settings->pollMax : transport->pollMax) * 1000UL;
+  if (pollCeiling < SCSIWIFI_POLL_MIN) pollCeiling = SCSIWIFI_POLL_MIN;
 
   D(("scsidayna_task: starting loop 1.0\n"));
   while (!(recv & SIGBREAKF_CTRL_C)) {
-    struct IOSana2Req *ior = NULL, *nextwrite;
+    struct IOSana2Req *ior = NULL;
     USHORT shouldBeEnabled = db->db_online;
 
+    // Nobody has the device open.  Polling stops, but the DaynaPORT stays enabled and buffering,
+    // until it's opened again or LINGER seconds are up
+    if (db->db_Lingering == LINGER_YES) {
+      struct timeval lingerStart, now;
+      UBYTE stay = 1;
+      SCSIWifi_cancelReceives(scsiDevice);
+      txHolding = 0;
+      rejectAllPackets(db);
+      ObtainSemaphore(&db->db_SampleListSem);
+      reject_list(db, (struct List*)&db->db_SampleList);
+      ReleaseSemaphore(&db->db_SampleListSem);
+      D(("scsidayna_task: lingering\n"));
+      GetSysTime(&lingerStart);
+      ReleaseSemaphore(&db->db_ActiveSem);
+      while (stay) {
+        time_req->tr_time.tv_micro = 250 * 1000L;
+        SendIO((struct IORequest *)time_req);
+        recv = Wait(SIGBREAKF_CTRL_C | timerSignalMask | SIGBREAKF_CTRL_F);
+        if (!CheckIO((struct IORequest *)time_req)) AbortIO((struct IORequest *)time_req);
+        WaitIO((struct IORequest *)time_req);
+        SetSignal(0, timerSignalMask);
+        GetSysTime(&now);
+        // Going is decided in Forbid so DevOpen either sees it still here and keeps it, or gone
+        Forbid();
+        // Opened again.  DevOpen has already said it's running, so an Expunge's CTRL_C that came in alongside doesn't count
+        if (db->db_Lingering == LINGER_NO) {
+          recv &= ~SIGBREAKF_CTRL_C;
+          stay = 0;
+        } else
+        if ((db->db_Lingering == LINGER_YES) && ((recv & SIGBREAKF_CTRL_C) || (now.tv_secs - lingerStart.tv_secs >= settings->linger))) {
+          db->db_Proc = NULL;
+          if (db->db_RxPool) FreeVec(db->db_RxPool);
+          db->db_RxPool = NULL;
+          recv = SIGBREAKF_CTRL_C;
+          stay = 0;
+        }
+        Permit();
+      }
+      if (recv & SIGBREAKF_CTRL_C) {
+        lingered = 1;
+        break;
+      }
+      ObtainSemaphore(&db->db_ActiveSem);
+      D(("scsidayna_task: opened again\n"));
+      pollMicros = SCSIWIFI_POLL_MIN;
+      linkSuspect = 1;
+      recv = 0;
+      continue;
+    }
+
     GetSysTime(&timeWifiCheck);
-    // Every 5 seconds check WIFI status
-    if (abs(timeWifiCheck.tv_secs-timeLastWifiCheck.tv_secs)>=5) {
-      struct SCSIWifi_NetworkEntry wifi;
-      if (SCSIWifi_getNetwork(scsiDevice, &wifi)) {
-        if (wifi.rssi == 0) {
-          D(("scsidayna_task: WIFI not connected\n"));
-          lastWifiStatus = 0;
-        } else {
-          lastWifiStatus = 1;
-          D(("scsidayna_task: WIFI connected with strength %ld dB\n", wifi.rssi));
+    // Every LINK_WATCH_MICROS look at the traffic to decide if the WIFI status is worth asking for.  Frames
+    // arriving mean the link's up.  Frames that stop, or go out with nothing coming back, get a check straight away
+    if ((timeWifiCheck.tv_secs - linkWatch.tv_secs >= 2) ||
+        ((timeWifiCheck.tv_secs - linkWatch.tv_secs) * 1000000UL + timeWifiCheck.tv_micro - linkWatch.tv_micro >= LINK_WATCH_MICROS)) {
+      ULONG received = db->db_DevStats.PacketsReceived, sent = db->db_DevStats.PacketsSent;
+      ULONG since = timeWifiCheck.tv_secs - timeLastWifiCheck;
+      UBYTE flowing = (received != linkReceived);
+      UBYTE check;
+      if (linkSuspect) check = 1; else
+      if (flowing) check = (since >= LINK_CHECK_BUSY); else
+      if ((linkFlowing) || (sent != linkSent)) check = 1;
+      else check = (since >= LINK_CHECK_QUIET);
+      linkWatch = timeWifiCheck;
+      linkReceived = received;
+      linkSent = sent;
+      linkFlowing = flowing;
+
+      if (check) {
+        struct SCSIWifi_NetworkEntry wifi;
+        timeLastWifiCheck = timeWifiCheck.tv_secs;
+        linkSuspect = 1;
+        if (SCSIWifi_getNetwork(scsiDevice, &wifi)) {
+          db->db_Rssi = wifi.rssi;
+          db->db_Channel = wifi.channel;
+          db->db_RssiHistory[db->db_LinkChecks % RSSI_HISTORY] = wifi.rssi;
+          db->db_LinkChecks++;
+          if (wifi.rssi == 0) {
+            D(("scsidayna_task: WIFI not connected\n"));
+            lastWifiStatus = 0;
+          } else {
+            lastWifiStatus = 1;
+            linkSuspect = 0;
+            D(("scsidayna_task: WIFI connected with strength %ld dB\n", wifi.rssi));
+          }
         }
       }
-      timeLastWifiCheck.tv_secs = timeWifiCheck.tv_secs;
     }
     if (!lastWifiStatus) shouldBeEnabled = 0;
 
+    // Connected time and throughput samplers move on at most every SAMPLE_INTERVAL_MICROS
+    {
+      ULONG secs = timeWifiCheck.tv_secs - db->db_SampleTime.tv_secs;
+      if ((secs >= 2) || ((secs * 1000000UL + timeWifiCheck.tv_micro - db->db_SampleTime.tv_micro) >= SAMPLE_INTERVAL_MICROS)) {
+        if (currentWifiState) {
+          struct timeval connected = timeWifiCheck;
+          SubTime(&connected, &db->db_LastConnected);
+          AddTime(&connected, &timeConnectedBefore);
+          db->db_TimeConnected = connected;
+        }
+        update_samplers(db, &timeWifiCheck);
+      }
+    }
+
     // Handle state toggle - also goes offline if theres no connections
     if (currentWifiState != shouldBeEnabled) {
       currentWifiState = shouldBeEnabled;
+      SCSIWifi_cancelReceives(scsiDevice);
       SCSIWifi_enable(scsiDevice, shouldBeEnabled); 
       if (!shouldBeEnabled) rejectAllPackets(db);
-      if (shouldBeEnabled) GetSysTime(&db->db_DevStats.LastStart);
-      DoEvent(db, shouldBeEnabled ? S2EVENT_ONLINE : S2EVENT_OFFLINE);
+      if (shouldBeEnabled) {
+        // Enabling forgets the multicast addresses, so they all go again
+        db->db_MulticastsChanged = 1;
+        GetSysTime(&db->db_DevStats.LastStart);
+        db->db_LastConnected = db->db_DevStats.LastStart;
+        timeConnectedBefore = db->db_TimeConnected;
+      } else if (db->db_LastConnected.tv_secs) {
+        struct timeval connected;
+        GetSysTime(&db->db_LastDisconnected);
+        connected = db->db_LastDisconnected;
+        SubTime(&connected, &db->db_LastConnected);
+        AddTime(&timeConnectedBefore, &connected);
+        db->db_TimeConnected = timeConnectedBefore;
+      }
+      // Set first, so anyone woken by S2EVENT_ONLINE can send straight away
       db->db_currentWifiState = currentWifiState;
+      DoEvent(db, shouldBeEnabled ? S2EVENT_ONLINE : S2EVENT_OFFLINE);
     }
     
+    if ((currentWifiState) && (db->db_MulticastsChanged)) push_multicasts(db, scsiDevice);
+
     if (currentWifiState) {
       UBYTE morePackets = 0;
+      ULONG holdMicros = 0;     // how much longer a part filled batch is being held for
       USHORT counter = 0;   
+      ULONG receivedBefore = db->db_DevStats.PacketsReceived;
       do {
-        USHORT packetSize = SCSIWIFI_PACKET_MAX_SIZE + 6;
-        if (SCSIWifi_receiveFrame(scsiDevice, packetData, &packetSize)) {    
-          morePackets = packetData[5];
-          db->db_DevStats.PacketsReceived++;
-
-          if (packetSize > 6) {
-            USHORT packet_type = ((USHORT)packetData[18]<<8)|((USHORT)packetData[19]);   
-
-            ObtainSemaphore(&db->db_ReadListSem);
-            for (ior = (struct IOSana2Req *)db->db_ReadList.lh_Head; ior->ios2_Req.io_Message.mn_Node.ln_Succ; ior = (struct IOSana2Req *)ior->ios2_Req.io_Message.mn_Node.ln_Succ) {
-              if (ior->ios2_PacketType == packet_type) {
-                Remove((struct Node*)ior);
-                read_frame(db, ior, packetData, packetSize);        
-                DevTermIO(db, (struct IORequest *)ior);
-                counter++;
-                ior = NULL;
-                break;
-              }
+        UBYTE* frames = NULL;
+        USHORT packetSize = 0;
+        // Reads run in the background.  As soon as one says more is waiting the next is started,
+        // so it crosses the bus while these frames are handed to the stack
+        TRACE(db->db_Trace, teRxLoop, 0, NULL);
+        if (!SCSIWifi_receivesPending(scsiDevice)) SCSIWifi_startReceive(scsiDevice);
+        if (SCSIWifi_collectReceive(scsiDevice, &frames, &packetSize)) {    
+          // The buffer may hold several frames, each handed over straight from where it landed
+          UBYTE* frame = frames;
+          BOOL held;
+          ULONG arrived = eclock_now(db);
+          TRACE(db->db_Trace, teRxFrames, packetSize, NULL);
+          UBYTE* frameEnd = frames + packetSize;
+
+          // The last header says if the DaynaPORT has more waiting
+          morePackets = 0;
+          while (frame + 6 <= frameEnd) {
+            USHORT frameSize = ((USHORT)frame[0]<<8)|((USHORT)frame[1]);
+            morePackets = frame[5] & SCSIWIFI_FLAG_MORE_FRAMES;
+            if ((!frameSize) || (!(frame[5] & SCSIWIFI_FLAG_RECORD_FOLLOWS))) break;
+            frame += (6 + frameSize + 1) & ~1;
+          }
+          if (morePackets) SCSIWifi_startReceive(scsiDevice);
+
+          frame = frames;
+          while (frame + 6 <= frameEnd) {
+            USHORT frameSize = ((USHORT)frame[0]<<8)|((USHORT)frame[1]);
+            UBYTE flags = frame[5];
+            if (!frameSize) break;
+            if (frame + 6 + frameSize > frameEnd) {
+              db->db_DevStats.BadData++;    // runs off the end of what was read
+              break;
             }
-            ReleaseSemaphore(&db->db_ReadListSem);
-
-            // Nothing wanted it?
-            if (ior) {
+            USHORT wireSize = frameSize > 4 ? frameSize - 4 : 0;    // without the CRC
+            db->db_DevStats.PacketsReceived++;
+            add_quad(&db->db_BytesReceived, wireSize);
+
+            USHORT packet_type = ((USHORT)frame[18]<<8)|((USHORT)frame[19]);   
+
+            // The list is only held while the request is taken off it, not during the copy
+            if (!frame_wanted(db, frame + 6)) {
+              // For another station, or a multicast to an address the stack never added
+              count_type(db, frame + 6, wireSize, FALSE, TRUE);
+            } else if ((ior = take_read(db, packet_type, frame, arrived, &held)) && (!filter_frame(db, ior, frame))) {
+              // The stack doesn't want it, so the read waits for the next one
+              return_read(db, ior);
+              count_type(db, frame + 6, wireSize, FALSE, TRUE);
+            } else if (ior) {
+              read_frame(db, ior, frame, frameSize + 6);        
+              DevTermIO(db, (struct IORequest *)ior);
+              SCSIWifi_addTime(&db->db_ReadTimes, eclock_now(db) - arrived);
+              count_type(db, frame + 6, wireSize, FALSE, FALSE);
+              counter++;
+            } else if (held) {
+              // Kept for the next CMD_READ of its type
+              count_type(db, frame + 6, wireSize, FALSE, FALSE);
+            } else {
+              // Nothing wanted it?
               db->db_DevStats.UnknownTypesReceived++;
               ObtainSemaphore(&db->db_ReadOrphanListSem);
               ior = (struct IOSana2Req *)RemHead((struct List*)&db->db_ReadOrphanList);
               ReleaseSemaphore(&db->db_ReadOrphanListSem);
-              if (ior) {
-                read_frame(db, ior, packetData, packetSize);
+              if ((ior) && (!filter_frame(db, ior, frame))) {
+                ObtainSemaphore(&db->db_ReadOrphanListSem);
+                AddHead((struct List*)&db->db_ReadOrphanList, (struct Node*)ior);
+                ReleaseSemaphore(&db->db_ReadOrphanListSem);
+                ior = NULL;
+              } else if (ior) {
+                read_frame(db, ior, frame, frameSize + 6);
                 DevTermIO(db, (struct IORequest *)ior);  
+                SCSIWifi_addTime(&db->db_ReadTimes, eclock_now(db) - arrived);
                 D(("Orphan Packet Picked Up (proto %lx) !\n", packet_type));
-              } 
+              } else db->db_RxDropped++;
+              count_type(db, frame + 6, wireSize, FALSE, ior == NULL);
             }
+
+            if (!(flags & SCSIWIFI_FLAG_RECORD_FOLLOWS)) break;
+            frame += (6 + frameSize + 1) & ~1;
           }
         } else {
           morePackets = 0;
           D(("RECV FAILED\n"));
           DoEvent(db, S2EVENT_ERROR | S2EVENT_HARDWARE | S2EVENT_RX);
+          linkSuspect = 1;
         }
+        SCSIWifi_releaseReceive(scsiDevice);
         recv = SetSignal(0, SIGBREAKF_CTRL_C|SIGBREAKF_CTRL_F);
         // Keep going until we're told theres no more data, or we need to send, or terminate
       } while ((morePackets) && (!recv));
@@ -901,29 +2010,54 @@ __saveds void frame_proc() {
       // Prevent delaying if there was data incoming
       if (counter >=2 ) morePackets = 1;
 
-      // Send packets
+      // Send packets.  With a TXWINDOW set, a part filled batch waits up to that long for more to join it
       ObtainSemaphore(&db->db_WriteListSem);
-      counter = 8;   // Max of 8 per loop      
-      for(ior = (struct IOSana2Req *)db->db_WriteList.lh_Head; (nextwrite = (struct IOSana2Req *) ior->ios2_Req.io_Message.mn_Node.ln_Succ) != NULL; ior = nextwrite ) {
-          ULONG res = write_frame(ior, packetData, scsiDevice, db);
-          Remove((struct Node*)ior);
-          DevTermIO(db, (struct IORequest *)ior);
+      counter = 0;
+      for(ior = (struct IOSana2Req *)db->db_WriteList.lh_Head; (ior->ios2_Req.io_Message.mn_Node.ln_Succ) && (counter < SCSIWIFI_TX_BATCH_MAX); ior = (struct IOSana2Req *)ior->ios2_Req.io_Message.mn_Node.ln_Succ) counter++;
+      ReleaseSemaphore(&db->db_WriteListSem);
+      if (counter) {
+        if ((settings->txWindow) && (counter < SCSIWIFI_TX_BATCH_MAX) && (SCSIWifi_canBatchWrites(scsiDevice))) {
+          struct timeval timeNow;
+          GetSysTime(&timeNow);
+          if (!txHolding) {
+            txHolding = 1;
+            txHoldStart = timeNow;
+            holdMicros = settings->txWindow;
+          } else {
+            ULONG secs = timeNow.tv_secs - txHoldStart.tv_secs;
+            ULONG held = secs * 1000000UL + timeNow.tv_micro - txHoldStart.tv_micro;
+            if ((secs < 2) && (held < settings->txWindow)) holdMicros = settings->txWindow - held;
+          }
+        }
+        // Held, it sleeps below rather than polling until the window's up
+        if (!holdMicros) {
+          txHolding = 0;
+          TRACE(db->db_Trace, teTxLoop, counter, NULL);
+          write_frames((UBYTE*)packetData, SCSIWIFI_RECEIVE_BUFFER_SIZE, scsiDevice, db);
           morePackets=1;
-          counter--;
-          if (!counter) break;
+        }
       }
-      ReleaseSemaphore(&db->db_WriteListSem);
+
+      if ((morePackets) || (db->db_DevStats.PacketsReceived != receivedBefore)) pollMicros = SCSIWIFI_POLL_MIN;
 
       if (recv & SIGBREAKF_CTRL_C) {
         D(("Terminate Requested"));
       } else {
         if (!morePackets) {
-          // we use unit VBLANK therefore the granularity of our wait will be 1/50th (1/60th)
-          // of a second. So essentially this will wait until the next vblank, unless
-          // signaled, which is good enough to yield.
-          time_req->tr_time.tv_micro = 1L;
+          // Nothing to do, sleep until the next poll is due, a held batch has waited long enough, or a CMD_WRITE arrives
+          time_req->tr_time.tv_micro = ((holdMicros) && (holdMicros < pollMicros)) ? holdMicros : pollMicros;
           SendIO((struct IORequest *)time_req);
+          TRACE(db->db_Trace, teWait, time_req->tr_time.tv_micro, NULL);
           recv = Wait(SIGBREAKF_CTRL_C | timerSignalMask | SIGBREAKF_CTRL_F);
+          TRACE(db->db_Trace, teWake, recv, NULL);
+          if (!CheckIO((struct IORequest *)time_req)) AbortIO((struct IORequest *)time_req);
+          WaitIO((struct IORequest *)time_req);
+          SetSignal(0, timerSignalMask);   // an aborted request leaves its signal behind
+
+          if (recv & SIGBREAKF_CTRL_F) pollMicros = SCSIWIFI_POLL_MIN; else {
+            pollMicros <<= 1;
+            if (pollMicros > pollCeiling) pollMicros = pollCeiling;
+          }
         }
       }
     } else {
@@ -931,20 +2065,37 @@ __saveds void frame_proc() {
         time_req->tr_time.tv_micro = 250 * 1000L;
         SendIO((struct IORequest *)time_req);
         recv = Wait(SIGBREAKF_CTRL_C | timerSignalMask | SIGBREAKF_CTRL_F);
-        AbortIO((struct IORequest *)time_req);
+        if (!CheckIO((struct IORequest *)time_req)) AbortIO((struct IORequest *)time_req);
+        WaitIO((struct IORequest *)time_req);
+        SetSignal(0, timerSignalMask);
+        pollMicros = SCSIWIFI_POLL_MIN;
     }
   }
 
+  SCSIWifi_cancelReceives(scsiDevice);
   SCSIWifi_enable(scsiDevice, 0); 
-  DoEvent(db, S2EVENT_OFFLINE);
-  rejectAllPackets(db);
+  db->db_currentWifiState = 0;
+  if (!lingered) {
+    DoEvent(db, S2EVENT_OFFLINE);
+    rejectAllPackets(db);
+    ObtainSemaphore(&db->db_SampleListSem);
+    reject_list(db, (struct List*)&db->db_SampleList);
+    ReleaseSemaphore(&db->db_SampleListSem);
+  }
   FreeVec(packetData);
+  db->db_TimerBase = NULL;
+#ifdef SCSIDAYNA_TRACE
+  if (db->db_Trace) db->db_Trace->tr_TimerBase = NULL;
+#endif
+  SCSIWifi_setTiming(scsiDevice, NULL, NULL);
+  SCSIWifi_setTrace(scsiDevice, NULL);
   CloseDevice((struct IORequest *)time_req);
   DeleteIORequest((struct IORequest *)time_req);
   FreeSignal(timerPort.mp_SigBit);
-  SCSIWifi_close(scsiDevice);
+  SCSIWifi_release(scsiDevice);
 
   Forbid();
+  if (!lingered) ReleaseSemaphore(&db->db_ActiveSem);
   ReleaseSemaphore(&db->db_ProcSem);
   D(("scsidayna_task: shutdown\n"));
 }
@@ -34,6 +34,8 @@
 #include <exec/semaphores.h>
 #include "debug.h"
 #include "sana2.h"
+#include "scsiwifi.h"
+#include "trace.h"
 
 /* reassign Library bases from global definitions to own struct */
 #define SysBase       db->db_SysBase
@@ -50,6 +52,91 @@ struct DevUnit {
 	APTR	du_hwp2;
 };
 
+// CMD_READs are queued by packet type.  Types hash into a small table so the receive loop can
+// go straight to the requests waiting for a frame's type. Any type that doesn't fit goes on db_ReadList
+#define READ_TYPE_SLOTS 16      // must be a power of 2
+
+struct ReadTypeQueue {
+	ULONG rq_PacketType;
+	USHORT rq_InUse;
+	struct List rq_Requests;    // FIFO
+	struct List rq_Held;        // frames that arrived while rq_Requests was empty, oldest first
+};
+
+// A frame kept in the receive pool until a CMD_READ for its type turns up. Frames are only kept
+// for types that have been read, and once in the pool longer than RX_POOL_MAX_AGE they can be reused.
+// RXPOOL sets how many there are
+#define RX_POOL_MAX_AGE   1     // seconds
+
+struct HeldFrame {
+	struct MinNode hf_Node;
+	ULONG hf_Arrived;           // eclock_now() when it was read
+	UBYTE hf_Frame[(SCSIWIFI_PACKET_MAX_SIZE + 6 + 3) & ~3];   // as read: record header, frame, CRC
+};
+
+// S2_TRACKTYPE: per type packet counts, in a small table the receive and transmit paths
+// can look a type up in without walking anything.  db_TrackedTypes is 0 when nothing is tracked
+#define TRACK_TYPE_SLOTS 16     // must be a power of 2
+
+struct TrackedType {
+	ULONG tt_PacketType;
+	USHORT tt_Used;             // the slot has held a type, so lookups probe past it
+	USHORT tt_Users;            // S2_TRACKTYPEs outstanding, 0 = not tracked
+	struct Sana2PacketTypeStats tt_Stats;
+};
+
+// After the last close frame_proc stays for LINGER seconds, with the DaynaPORT still enabled, in case it's opened again
+#define LINGER_NO       0       // frame_proc is serving the device
+#define LINGER_YES      1       // nobody has the device open
+#define LINGER_CLAIMED  2       // DevOpen is setting up to use the lingering frame_proc
+
+// When each CMD_WRITE was queued, for the db_WriteTimes histogram.  The request belongs to the stack, so
+// this is kept here.  Writes queued while every slot is taken just aren't timed
+#define WRITE_STAMP_SLOTS 32
+
+struct WriteStamp {
+	struct IOSana2Req* ws_Request;  // NULL if the slot is free
+	ULONG ws_Queued;                // eclock_now() when it was queued
+};
+
+// S2_ADDMULTICASTADDRESS: the multicast addresses the stack wants, reference counted, in a small table
+// the receive path can look a frame's destination up in.  db_Multicasts is 0 when there are none
+#define MULTICAST_SLOTS 32      // must be a power of 2
+
+struct MulticastAddress {
+	UBYTE ma_Address[6];
+	USHORT ma_Used;             // the slot has held an address, so lookups probe past it
+	USHORT ma_Users;            // S2_ADDMULTICASTADDRESSes outstanding, 0 = not wanted
+};
+
+// S2_GETSPECIALSTATS records.  The SANA-II ethernet ones are (S2WireType_Ethernet<<16)|n, ours start at 0x8000
+#define S2SS_DAYNA_RXDROPPED      ((S2WireType_Ethernet<<16)|0x8000)
+#define S2SS_DAYNA_TXDROPPED      ((S2WireType_Ethernet<<16)|0x8001)
+#define S2SS_DAYNA_RSSI           ((S2WireType_Ethernet<<16)|0x8002)    // dBm, as a LONG. 0 = not connected
+#define S2SS_DAYNA_CHANNEL        ((S2WireType_Ethernet<<16)|0x8003)
+#define S2SS_DAYNA_ECLOCK         ((S2WireType_Ethernet<<16)|0x8004)    // EClock ticks per second, for the histograms
+#define S2SS_DAYNA_RXFILTERED     ((S2WireType_Ethernet<<16)|0x8005)    // frames the stack's S2_PacketFilter turned down
+#define S2SS_DAYNA_MCASTDROPPED   ((S2WireType_Ethernet<<16)|0x8006)    // multicasts to addresses nobody added
+#define S2SS_DAYNA_NOTOURS        ((S2WireType_Ethernet<<16)|0x8007)    // unicasts for another station
+#define S2SS_DAYNA_PROMISCUOUS    ((S2WireType_Ethernet<<16)|0x8008)    // frames passed on only because of SANA2OPF_PROM
+#define S2SS_DAYNA_LINKCHECKS     ((S2WireType_Ethernet<<16)|0x8009)    // times the DaynaPORT was asked about the link
+// The signal strength at the last RSSI_HISTORY link checks, 0 being the latest
+#define S2SS_DAYNA_RSSI_HISTORY(n) ((S2WireType_Ethernet<<16)|0x8010|(n))
+// Latency histograms, one record per bucket (see SCSIWIFI_HISTOGRAM_BUCKETS)
+#define S2SS_DAYNA_HISTOGRAM(histogram, bucket) ((S2WireType_Ethernet<<16)|0x8100|((histogram)<<4)|(bucket))
+enum SpecialHistogram {shScsiRead, shScsiWrite, shScsiOther, shWriteQueued, shReadDelivered, shCount};
+
+// How often (microseconds) S2_SAMPLE_THROUGHPUT requests are updated, at most
+#define SAMPLE_INTERVAL_MICROS 100000
+
+// Link checks.  The traffic is looked at every LINK_WATCH_MICROS, and anything suspicious gets a check then.
+// Frames arriving show the link is up, so it's only asked about every LINK_CHECK_BUSY seconds to keep the
+// RSSI history going, and every LINK_CHECK_QUIET seconds when nothing's happening
+#define LINK_WATCH_MICROS 500000
+#define LINK_CHECK_QUIET 2
+#define LINK_CHECK_BUSY 30
+#define RSSI_HISTORY 8
+
 struct devbase {
 	struct Library db_Lib;
 	BPTR db_SegList;            /* from Device Init */
@@ -66,16 +153,67 @@ struct devbase {
 	void* db_scsiSettings;    // A pointer to a ScsiDaynaSettings struct  
 	USHORT db_scsiDeviceID;	  // The device ID that should be used going forward (auto-detect)
 	USHORT db_scsiMode;       // Scsi mode
-	struct List db_ReadList;
-	struct SignalSemaphore db_ReadListSem;
+	struct ReadTypeQueue db_ReadTypes[READ_TYPE_SLOTS];
+	struct List db_ReadList;                // reads whose type didn't fit in db_ReadTypes
+	struct HeldFrame* db_RxPool;            // RXPOOL frames, allocated while the device is open, or NULL
+	struct List db_RxPoolFree;              // the ones not holding anything
+	struct SignalSemaphore db_ReadListSem;  // protects all of these
 	struct List db_WriteList;
 	struct SignalSemaphore db_WriteListSem;
+	struct WriteStamp db_WriteStamps[WRITE_STAMP_SLOTS];  // also under db_WriteListSem
 	struct List db_EventList;
 	struct SignalSemaphore db_EventListSem;   
 	struct List db_ReadOrphanList;
 	struct SignalSemaphore db_ReadOrphanListSem;
+	struct TrackedType db_TypeStats[TRACK_TYPE_SLOTS];
+	USHORT db_TrackedTypes;
+	struct SignalSemaphore db_TypeStatsSem;
+	struct List db_SampleList;              // S2_SAMPLE_THROUGHPUT requests
+	struct SignalSemaphore db_SampleListSem;
 	struct Process* db_Proc;
 	struct SignalSemaphore db_ProcSem;
+	struct SignalSemaphore db_ActiveSem;    // held by frame_proc except while it lingers
+	volatile UBYTE db_Lingering;            // LINGER_*
+	SCSIWIFIDevice db_ScsiDevice;           // opened by DevInit, used by frame_proc, closed on expunge
+
+	// Transmit coalescing statistics
+	ULONG db_TxCommands;                                // WRITE FRAME commands issued
+	ULONG db_TxBatchFrames[SCSIWIFI_TX_BATCH_MAX+1];    // how many of those carried 1, 2.. frames
+
+	// Extended statistics, all kept by frame_proc
+	S2QUAD db_BytesReceived;            // whole frames, without the CRC
+	S2QUAD db_BytesSent;
+	ULONG db_RxDropped;                 // frames no CMD_READ or S2_READORPHAN was waiting for
+	ULONG db_TxDropped;                 // writes that couldn't be sent
+	ULONG db_RxFiltered;                // frames the stack's S2_PacketFilter hook rejected
+	ULONG db_MulticastDropped;          // multicasts to addresses not in db_MulticastTable
+	ULONG db_RxNotOurs;                 // unicasts for another station
+	ULONG db_RxPromiscuous;             // frames either of those would have dropped, passed on in promiscuous mode
+	UBYTE db_Promiscuous;               // opened with SANA2OPF_PROM
+	struct MulticastAddress db_MulticastTable[MULTICAST_SLOTS];
+	USHORT db_Multicasts;               // addresses in the table with users
+	UBYTE db_MulticastFiltering;        // set by the first S2_ADDMULTICASTADDRESS, until then every multicast is passed on
+	volatile UBYTE db_MulticastsChanged;    // frame_proc has to tell the DaynaPORT
+	struct SignalSemaphore db_MulticastSem;
+	struct timeval db_LastConnected;
+	struct timeval db_LastDisconnected;
+	struct timeval db_TimeConnected;    // as of the last sample
+	struct timeval db_SampleTime;       // when the samplers were last updated
+	ULONG db_SampledReceived, db_SampledSent;   // db_BytesReceived/Sent low words at that point
+
+	// Latency histograms, in EClock ticks, and the radio as of the last check
+	struct Library* db_TimerBase;                   // frame_proc's, while it's running
+	ULONG db_EClockRate;
+	struct SCSIWifi_CommandTimes db_CommandTimes;   // each SCSI command
+	struct SCSIWifi_Histogram db_WriteTimes;        // CMD_WRITE queued until it's replied
+	struct SCSIWifi_Histogram db_ReadTimes;         // frame read from the DaynaPORT until its CMD_READ is replied
+	BYTE db_Rssi;
+	UBYTE db_Channel;
+	BYTE db_RssiHistory[RSSI_HISTORY];      // db_LinkChecks % RSSI_HISTORY is the next to go
+	ULONG db_LinkChecks;
+
+	struct TraceRing* db_Trace;     // only with SCSIDAYNA_TRACE, see trace.h
+	UWORD db_TraceOpens;            // of lib_OpenCnt, those on S2_DAYNA_TRACE_UNIT
 };
 
 #ifndef DEVBASETYPE
@@ -120,12 +258,19 @@ void DevTermIO( DEVBASETYPE*, struct IORequest * );
 #define HW_ETH_HDR_SIZE          14       /* ethernet header: dst, src, type */
 
 typedef BOOL (*BMFunc)(__reg("a0") void* a, __reg("a1") void* b, __reg("d0") long c);
+typedef APTR (*BMDMAFunc)(__reg("a0") void* a);
 
 typedef struct BufferManagement
 {
   struct MinNode   bm_Node;
   BMFunc           bm_CopyFromBuffer;
   BMFunc           bm_CopyToBuffer;
+  BMFunc           bm_CopyFromBuffer16;     /* optional, our end word aligned */
+  BMFunc           bm_CopyToBuffer16;
+  BMFunc           bm_CopyFromBuffer32;     /* optional, our end long aligned */
+  BMFunc           bm_CopyToBuffer32;
+  struct Hook*     bm_PacketFilter;         /* optional, says whether a frame is wanted before it's copied */
+  BMDMAFunc        bm_DMACopyFromBuffer32;  /* optional, NULL if the stack didn't offer it */
 } BufferManagement;
 
 #endif /* _INC_DEVICE_H */
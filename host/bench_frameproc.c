@@ -0,0 +1,867 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - frame_proc throughput benchmark
+ *
+ * Opens the device the way a TCP/IP stack would (CopyToBuff/CopyFromBuff
+ * callbacks, a handful of CMD_READs posted per packet type, CMD_WRITEs
+ * queued as they come) and pumps traffic through frame_proc against the
+ * DaynaPORT stand-in, then reports what it cost in SCSI commands.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <unistd.h>
+#include <getopt.h>
+#include "scsi_target.h"
+#include "device.h"
+
+#define ETHERTYPE_IPV4      0x0800
+#define ETHERTYPE_ARP       0x0806
+#define ETHERTYPE_IPV6      0x86DD
+
+#define MAX_REQUESTS        64
+#define PING_ECHO_MICROS    2000
+#define REQUEST_BUFFER_SIZE 1600
+
+enum BenchMode {bmDownload, bmUpload, bmIdle, bmPing};
+
+struct BenchRequest {
+    struct IOSana2Req req;          // must be first
+    BOOL  isWrite;
+    BOOL  inFlight;                 // posted and not yet back through GetMsg()
+    UBYTE buffer[REQUEST_BUFFER_SIZE];
+};
+
+struct BenchState {
+    enum BenchMode mode;
+    ULONG frameSize;                // ethernet frame size, no CRC
+    ULONG packetsPerSecond;         // download (or ping) rate, 0 = keep the DaynaPORT's buffer full
+    UBYTE stationMac[6];
+    UBYTE peerMac[6];
+
+    ULONG copyRate;                 // bytes/s the "CPU" copies at in the buffer callbacks, 0 = free
+    BOOL rawWrites;                 // CMD_WRITEs carry their own ethernet header
+    ULONG copies;                   // calls to the copy callbacks, including...
+    ULONG alignedCopies[2];         // ...the 16 and 32 bit ones
+    ULONG filterCalls;
+
+    uint64_t startTime;
+    ULONG pendingAcks;              // upload mode: ACKs owed to the driver
+    uint64_t nextPing;              // ping mode: when the next frame arrives from the network
+    ULONG random;
+
+    // Ping mode: how long frames sat in the DaynaPORT before the stack got them
+    uint64_t latencyTotal, latencyMax;
+    ULONG latencyCount;
+
+    // Counted in the main task as requests come back
+    ULONG readsDone, readBytes, readErrors;
+    ULONG writesDone, writeBytes, writeErrors;
+
+    // -l: the WiFi link drops, then comes back LINK_DROP_SECONDS later
+    uint64_t linkDropped, linkRestored;     // when, 0 = not yet
+    uint64_t offlineAfter, onlineAfter;     // how long until S2EVENT_OFFLINE/ONLINE, 0 = never came
+};
+
+#define LINK_DROP_SECONDS 3
+
+static struct BenchState bench;
+static struct DaynaTarget target;
+
+/****************************************************************************/
+/* Buffer management callbacks, as supplied by the "stack"                  */
+/****************************************************************************/
+
+// Charges the copy the time a slow CPU would take.  Spins, as the CPU is busy rather than waiting
+static void copyCost(long n) {
+    if (!bench.copyRate) return;
+    uint64_t end = HostShim_Micros() + ((uint64_t)n * 1000000ULL) / bench.copyRate;
+    while (HostShim_Micros() < end) {}
+}
+
+static BOOL copyToBuff(void* to, void* from, long n) {
+    bench.copies++;
+    if ((n < 0) || (n > REQUEST_BUFFER_SIZE)) return FALSE;
+    memcpy(to, from, n);
+    copyCost(n);
+    return TRUE;
+}
+
+// The stack's buffers are plain memory, so they can be handed straight to the driver
+static APTR dmaBuff(void* buffer) {
+    return buffer;
+}
+
+static BOOL copyFromBuff(void* to, void* from, long n) {
+    bench.copies++;
+    if ((n < 0) || (n > REQUEST_BUFFER_SIZE)) return FALSE;
+    memcpy(to, from, n);
+    copyCost(n);
+    return TRUE;
+}
+
+// The aligned variants insist on the driver's end of the copy being aligned as promised
+static BOOL copyToBuff16(void* to, void* from, long n) {
+    bench.alignedCopies[0]++;
+    return (!((uintptr_t)from & 1)) && copyToBuff(to, from, n);
+}
+
+static BOOL copyToBuff32(void* to, void* from, long n) {
+    bench.alignedCopies[1]++;
+    return (!((uintptr_t)from & 3)) && copyToBuff(to, from, n);
+}
+
+static BOOL copyFromBuff16(void* to, void* from, long n) {
+    bench.alignedCopies[0]++;
+    return (!((uintptr_t)to & 1)) && copyFromBuff(to, from, n);
+}
+
+static BOOL copyFromBuff32(void* to, void* from, long n) {
+    bench.alignedCopies[1]++;
+    return (!((uintptr_t)to & 3)) && copyFromBuff(to, from, n);
+}
+
+// S2_PacketFilter: like a stack with nothing listening for them, turns down broadcasts and multicasts other than ARP
+static IPTR packetFilter(struct Hook* hook, struct IOSana2Req* req, APTR data) {
+    (void)hook;
+    (void)data;
+    bench.filterCalls++;
+    return (!(req->ios2_DstAddr[0] & 1)) || (req->ios2_PacketType == ETHERTYPE_ARP);
+}
+
+/****************************************************************************/
+/* The "network" on the other side of the DaynaPORT                         */
+/****************************************************************************/
+
+static UWORD buildFrame(UBYTE* frame, UWORD size, UWORD type) {
+    memcpy(frame, bench.stationMac, 6);
+    memcpy(frame + 6, bench.peerMac, 6);
+    frame[12] = type >> 8;
+    frame[13] = type & 0xFF;
+    for (UWORD i = 14; i < size; i++) frame[i] = (UBYTE)i;
+    return size;
+}
+
+static UWORD frameSource(void* context, UBYTE* frame, UWORD maxSize) {
+    (void)context;
+    (void)maxSize;
+    // The echo of a ping, stamped with when it arrived
+    if (bench.mode == bmPing) {
+        if (HostShim_Micros() < bench.nextPing) return 0;
+        UWORD size = buildFrame(frame, 60, ETHERTYPE_IPV4);
+        memcpy(frame + 14, &bench.nextPing, sizeof(bench.nextPing));
+        bench.nextPing = ~0ULL;
+        return size;
+    }
+
+    // Downloads come from the target's own bulk generator, this is just the
+    // ACKs for uploads.  The far end ACKs every other segment
+    if ((bench.mode != bmUpload) || (!bench.pendingAcks)) return 0;
+    bench.pendingAcks--;
+    return buildFrame(frame, 60, ETHERTYPE_IPV4);
+}
+
+static void frameSink(void* context, const UBYTE* frame, UWORD size) {
+    static ULONG segments = 0;
+    (void)context;
+    (void)frame;
+    (void)size;
+    if ((bench.mode == bmUpload) && ((++segments & 1) == 0)) bench.pendingAcks++;
+    // The far end echoes pings a couple of milliseconds later
+    if (bench.mode == bmPing) bench.nextPing = HostShim_Micros() + PING_ECHO_MICROS;
+}
+
+/****************************************************************************/
+/* Benchmark                                                                */
+/****************************************************************************/
+
+static void usage(const char* name) {
+    printf("Usage: %s [-m download|upload|idle|ping] [-t seconds] [-s framesize] [-p packets/sec]\n"
+           "          [-M scsimode] [-r reads] [-w writes] [-c none|a590|a2091|gvp]\n"
+           "          [-x arp|storm|others]... [-b buffer slots] [-W microseconds] [-P milliseconds] [-q frames]\n"
+           "          [-k KB/s] [-B] [-1] [-T] [-H] [-D tracefile] [-a] [-d] [-f] [-g] [-o] [-F] [-R]\n"
+           "          [-i scsi id] [-I] [-L seconds] [-O] [-l seconds] [-N driver]\n"
+           "  -m ping sends -p pings a second, echoed 2ms later, and reports how long echoes waited\n"
+           "  -M sets MODE, the READ variant.  -1 (the default) uses what the SCSI driver is known to need, or has\n"
+           "     the driver calibrate it, -I then remembering it\n"
+           "  -N names the SCSI driver, instead of the one that goes with -c, to try its transport settings\n"
+           "  -k makes the stack's buffer copies run at this speed, as a slow CPU would\n"
+           "  -W sets TXWINDOW, how long a part filled transmit batch may wait for more frames\n"
+           "  -P sets POLLMAX, the longest gap between polls when the link is idle, 0 (the default) the driver's own\n"
+           "  -q sets RXPOOL, how many frames can be kept for CMD_READs not yet queued\n"
+           "  -B sets BATCH=1, so the driver asks for several frames per READ and WRITE FRAME\n"
+           "  -1 makes the DaynaPORT behave like firmware without batching, one frame per READ or WRITE\n"
+           "  -T tracks the IPv4, ARP and IPv6 types with S2_TRACKTYPE and reports their counts\n"
+           "  -H prints the driver's latency histograms from S2_GETSPECIALSTATS\n"
+           "  -a offers S2_CopyToBuff16/32 and S2_CopyFromBuff16/32, and reports how often each was used\n"
+           "  -d offers S2_DMACopyFromBuff32, so outgoing frames skip the stack's copy (and -k)\n"
+           "  -f gives an S2_PacketFilter hook that turns down broadcasts and multicasts other than ARP\n"
+           "  -g joins the mDNS, IPv6 all nodes and spanning tree groups, then leaves spanning tree again,\n"
+           "     so with -x storm the driver has to drop what the DaynaPORT still passes on\n"
+           "  -x others adds unicasts between other stations, which only -F lets through\n"
+           "  -o opens the device with SANA2OPF_PROM\n"
+           "  -F makes the DaynaPORT pass on every frame, with no address filter of its own\n"
+           "  -i puts the DaynaPORT on this SCSI ID (4), for auto-detect to find\n"
+           "  -I starts the device once beforehand, so the timed start uses the ID it remembered\n"
+           "  -L sets LINGER, how long the SCSI side stays up after the last close\n"
+           "  -O closes the device and opens it again before the run, and reports how long the link took to come back\n"
+           "     and whether an S2_ONEVENT left queued was aborted by the close\n"
+           "  -l drops the WiFi link this far into the run, for %d seconds, and reports how soon S2_ONEVENT saw it\n"
+           "  -R sends CMD_WRITEs as SANA2IOF_RAW frames, ethernet header included\n"
+           "  -D records the run with S2_DAYNA_TRACE (build with trace=1) and saves it for trace_decode\n", name, LINK_DROP_SECONDS);
+}
+
+static BOOL writePrefs(const char* dir, const char* driverName, int scsiMode, int txWindow, int pollMax, int rxPool, int linger, BOOL batch) {
+    char path[600];
+    snprintf(path, sizeof(path), "%s/scsidayna.prefs", dir);
+    FILE* f = fopen(path, "w");
+    if (!f) return FALSE;
+    fprintf(f, "DEVICE=%s\nDEVICEID=-1\nPRIORITY=0\nMODE=%d\nAUTOCONNECT=0\nSSID=\nKEY=\nTXWINDOW=%d\nPOLLMAX=%d\nRXPOOL=%d\nLINGER=%d\nBATCH=%d\n", driverName, scsiMode, txWindow, pollMax, rxPool, linger, batch ? 1 : 0);
+    fclose(f);
+    return TRUE;
+}
+
+// The main loop's tick.  In ping mode it sends the pings, at random-ish intervals so
+// they don't lock step with the driver's polling
+static ULONG tickMicros(void) {
+    if (bench.mode != bmPing) return 100000;
+    ULONG interval = 1000000UL / bench.packetsPerSecond;
+    bench.random = bench.random * 1103515245UL + 12345UL;
+    return (interval / 2) + ((bench.random >> 8) % interval);
+}
+
+static const UWORD trackedTypes[] = {ETHERTYPE_IPV4, ETHERTYPE_ARP, ETHERTYPE_IPV6};
+#define TRACKED_TYPE_COUNT (sizeof(trackedTypes) / sizeof(trackedTypes[0]))
+
+// Runs one of the commands that complete straight away, returning io_Error
+static BYTE quickCommand(struct IOSana2Req* req, struct devbase* db, UWORD command, ULONG packetType, APTR statData) {
+    req->ios2_Req.io_Command = command;
+    req->ios2_Req.io_Flags = SANA2IOF_QUICK;
+    req->ios2_PacketType = packetType;
+    req->ios2_StatData = statData;
+    DevBeginIO(req, db);
+    return req->ios2_Req.io_Error;
+}
+
+// S2_ADD/DELMULTICASTADDRESS(ES), returning io_Error.  high is only for the ranges
+static BYTE multicastCommand(struct IOSana2Req* req, struct devbase* db, UWORD command, const UBYTE* low, const UBYTE* high) {
+    req->ios2_Req.io_Command = command;
+    req->ios2_Req.io_Flags = SANA2IOF_QUICK;
+    memcpy(req->ios2_SrcAddr, low, 6);
+    if (high) memcpy(req->ios2_DstAddr, high, 6);
+    DevBeginIO(req, db);
+    return req->ios2_Req.io_Error;
+}
+
+static void postRequest(struct BenchRequest* br, struct devbase* db) {
+    struct IOSana2Req* req = &br->req;
+    req->ios2_Req.io_Flags = 0;
+    req->ios2_Req.io_Error = 0;
+    req->ios2_Data = br->buffer;
+    br->inFlight = TRUE;
+    if (br->isWrite) {
+        UWORD payload = (bench.mode == bmUpload) ? bench.frameSize - HW_ETH_HDR_SIZE : 40;
+        req->ios2_Req.io_Command = CMD_WRITE;
+        req->ios2_DataLength = payload;
+        memcpy(req->ios2_DstAddr, bench.peerMac, 6);
+        if (bench.rawWrites) {
+            req->ios2_Req.io_Flags = SANA2IOF_RAW;
+            req->ios2_DataLength = buildFrame(br->buffer, payload + HW_ETH_HDR_SIZE, ETHERTYPE_IPV4);
+            memcpy(br->buffer, bench.peerMac, 6);
+            memcpy(br->buffer + 6, bench.stationMac, 6);
+        }
+    } else {
+        req->ios2_Req.io_Command = CMD_READ;
+        req->ios2_DataLength = 0;
+    }
+    DevBeginIO(req, db);
+}
+
+int main(int argc, char** argv) {
+    int seconds = 5, scsiMode = -1, reads = 16, writes = 8, slots = DAYNATARGET_DEFAULT_SLOTS, txWindow = 0, pollMax = SCSIWIFI_POLL_MAX_DEFAULT, rxPool = SCSIWIFI_RX_POOL_DEFAULT, opt;
+    BOOL singleFrameReads = FALSE, trackTypes = FALSE, histograms = FALSE, dma = FALSE, aligned = FALSE, filter = FALSE, multicasts = FALSE, promiscuous = FALSE, passAll = FALSE, remembered = FALSE, reopen = FALSE, batch = FALSE;
+    int scsiID = 4, linger = SCSIWIFI_LINGER_DEFAULT, linkDropAt = 0;
+    const char* traceFile = NULL;
+    const char* driverName = NULL;
+    const struct DaynaTarget_Timing* timing = &DaynaTarget_TimingNone;
+    struct DaynaTarget_Traffic traffic;
+    memset(&traffic, 0, sizeof(traffic));
+    static const UBYTE peer[6] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+    memset(&bench, 0, sizeof(bench));
+    bench.mode = bmDownload;
+    bench.frameSize = 1514;
+    bench.nextPing = ~0ULL;         // nothing to echo yet
+
+    while ((opt = getopt(argc, argv, "m:t:s:p:M:r:w:c:x:b:W:P:k:D:q:i:L:l:N:adfgoF1BORTIHh")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (strcmp(optarg, "download") == 0) bench.mode = bmDownload; else
+                if (strcmp(optarg, "upload") == 0) bench.mode = bmUpload; else
+                if (strcmp(optarg, "idle") == 0) bench.mode = bmIdle; else
+                if (strcmp(optarg, "ping") == 0) bench.mode = bmPing; else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 't': seconds = atoi(optarg); break;
+            case 's': bench.frameSize = atoi(optarg); break;
+            case 'p': bench.packetsPerSecond = atoi(optarg); break;
+            case 'M': scsiMode = atoi(optarg); break;
+            case 'r': reads = atoi(optarg); break;
+            case 'w': writes = atoi(optarg); break;
+            case 'b': slots = atoi(optarg); break;
+            case 'W': txWindow = atoi(optarg); break;
+            case 'P': pollMax = atoi(optarg); break;
+            case 'q': rxPool = atoi(optarg); break;
+            case 'k': bench.copyRate = atoi(optarg) * 1024; break;
+            case '1': singleFrameReads = TRUE; break;
+            case 'B': batch = TRUE; break;
+            case 'T': trackTypes = TRUE; break;
+            case 'H': histograms = TRUE; break;
+            case 'D': traceFile = optarg; break;
+            case 'd': dma = TRUE; break;
+            case 'a': aligned = TRUE; break;
+            case 'f': filter = TRUE; break;
+            case 'g': multicasts = TRUE; break;
+            case 'o': promiscuous = TRUE; break;
+            case 'i': scsiID = atoi(optarg) & 7; break;
+            case 'I': remembered = TRUE; break;
+            case 'L': linger = atoi(optarg); break;
+            case 'O': reopen = TRUE; break;
+            case 'l': linkDropAt = atoi(optarg); break;
+            case 'N': driverName = optarg; break;
+            case 'F': passAll = TRUE; break;
+            case 'R': bench.rawWrites = TRUE; break;
+            case 'c':
+                if (!(timing = DaynaTarget_FindTiming(optarg))) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'x':
+                // Background traffic on top of the main mode
+                if (strcmp(optarg, "arp") == 0) traffic.arpRate = 20; else
+                if (strcmp(optarg, "storm") == 0) traffic.broadcastRate = 400; else
+                if (strcmp(optarg, "others") == 0) traffic.strangerRate = 400; else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((bench.mode == bmPing) && (!bench.packetsPerSecond)) bench.packetsPerSecond = 10;
+    if (bench.frameSize < 60) bench.frameSize = 60;
+    if (bench.frameSize > 1514) bench.frameSize = 1514;
+    if (reads < 4) reads = 4;
+    if (reads + writes > MAX_REQUESTS) writes = MAX_REQUESTS - reads;
+    if (slots < 1) slots = 1;
+    if (slots > DAYNATARGET_MAX_SLOTS) slots = DAYNATARGET_MAX_SLOTS;
+    if (txWindow < 0) txWindow = 0;
+    if (txWindow > 65535) txWindow = 65535;
+
+    // Private ENV: with a prefs file for the requested mode
+    char envDir[] = "/tmp/scsidayna-bench-XXXXXX";
+    if ((!mkdtemp(envDir)) || (!writePrefs(envDir, driverName ? driverName : timing->driverName, scsiMode, txWindow, pollMax, rxPool, linger, batch))) {
+        printf("Unable to create ENV: directory\n");
+        return 1;
+    }
+    HostShim_SetEnvDirs(envDir, envDir);
+
+    DaynaTarget_Init(&target);
+    target.source = frameSource;
+    target.sink = frameSink;
+    target.timing = timing;
+    target.ringSlots = slots;
+    target.batchedReads = !singleFrameReads;
+    target.passAll = passAll;
+    target.scsiID = scsiID;
+    DaynaTarget_Install(&target);
+    memcpy(bench.stationMac, target.mac, 6);
+    memcpy(bench.peerMac, peer, 6);
+
+    // Load the device.  MakeLibrary/AddDevice would normally put it on exec's device list
+    static struct ExecBase execBase;
+    static struct List deviceList;
+    NewList(&deviceList);
+    struct devbase* db;
+    if (remembered) {
+        db = AllocMem(sizeof(struct devbase), MEMF_PUBLIC | MEMF_CLEAR);
+        db->db_Lib.lib_PosSize = sizeof(struct devbase);
+        if (DevInit(db, 0, (struct Library*)&execBase)) {
+            AddTail(&deviceList, (struct Node*)db);
+            DevExpunge(db);
+        }
+    }
+    db = AllocMem(sizeof(struct devbase), MEMF_PUBLIC | MEMF_CLEAR);
+    db->db_Lib.lib_PosSize = sizeof(struct devbase);
+    uint64_t initStart = HostShim_Micros();
+    if (!DevInit(db, 0, (struct Library*)&execBase)) {
+        printf("DevInit failed\n");
+        return 1;
+    }
+    double initMillis = (HostShim_Micros() - initStart) / 1000.0;
+    AddTail(&deviceList, (struct Node*)db);
+
+    struct MsgPort* port = CreateMsgPort();
+    static struct Hook filterHook;
+    filterHook.h_Entry = (IPTR (*)())packetFilter;
+    struct TagItem bufferTags[] = {
+        {S2_CopyToBuff, (IPTR)copyToBuff},
+        {S2_CopyFromBuff, (IPTR)copyFromBuff},
+        {aligned ? S2_CopyToBuff16 : TAG_IGNORE, (IPTR)copyToBuff16},
+        {aligned ? S2_CopyFromBuff16 : TAG_IGNORE, (IPTR)copyFromBuff16},
+        {aligned ? S2_CopyToBuff32 : TAG_IGNORE, (IPTR)copyToBuff32},
+        {aligned ? S2_CopyFromBuff32 : TAG_IGNORE, (IPTR)copyFromBuff32},
+        {filter ? S2_PacketFilter : TAG_IGNORE, (IPTR)&filterHook},
+        {dma ? S2_DMACopyFromBuff32 : TAG_IGNORE, (IPTR)dmaBuff},
+        {TAG_DONE, 0}
+    };
+    struct IOSana2Req openReq;
+    memset(&openReq, 0, sizeof(openReq));
+    openReq.ios2_Req.io_Message.mn_ReplyPort = port;
+    openReq.ios2_Req.io_Message.mn_Length = sizeof(openReq);
+    openReq.ios2_BufferManagement = bufferTags;
+    if (DevOpen(&openReq, 0, promiscuous ? SANA2OPF_PROM : 0, db)) {
+        printf("DevOpen failed\n");
+        return 1;
+    }
+
+    // Wait for frame_proc to bring the link up.  This polls rather than using
+    // S2_ONEVENT as the state flag is set just after the event is sent
+    for (int i = 0; (i < 250) && (!db->db_currentWifiState); i++) Delay(1);
+    if (!db->db_currentWifiState) {
+        printf("Link did not come up\n");
+        return 1;
+    }
+
+    // A stack restarting: close, then open again straight away
+    double reopenMillis = 0;
+    ULONG reopenInquiries = 0;
+    BOOL closeAborted = FALSE;
+    if (reopen) {
+        ULONG inquiriesBefore = HostShim_Stats.scsiOpcodes[0x12];
+        // Left waiting on an event that won't come, it should be handed back by the close
+        struct IOSana2Req closeEventReq = openReq;
+        closeEventReq.ios2_Req.io_Command = S2_ONEVENT;
+        closeEventReq.ios2_Req.io_Flags = 0;
+        closeEventReq.ios2_WireError = S2EVENT_HARDWARE;
+        DevBeginIO(&closeEventReq, db);
+        DevClose((struct IORequest*)&openReq, db);
+        closeAborted = (GetMsg(port) == (struct Message*)&closeEventReq) && (closeEventReq.ios2_Req.io_Error == IOERR_ABORTED);
+        uint64_t reopenStart = HostShim_Micros();
+        openReq.ios2_BufferManagement = bufferTags;
+        if (DevOpen(&openReq, 0, promiscuous ? SANA2OPF_PROM : 0, db)) {
+            printf("DevOpen failed on reopening\n");
+            return 1;
+        }
+        while ((!db->db_currentWifiState) && (HostShim_Micros() - reopenStart < 5000000ULL)) usleep(200);
+        reopenMillis = (HostShim_Micros() - reopenStart) / 1000.0;
+        reopenInquiries = HostShim_Stats.scsiOpcodes[0x12] - inquiriesBefore;
+        if (!db->db_currentWifiState) {
+            printf("Link did not come back\n");
+            return 1;
+        }
+    }
+
+    if (trackTypes) {
+        struct IOSana2Req trackReq = openReq;
+        for (int i = 0; i < TRACKED_TYPE_COUNT; i++) {
+            if (quickCommand(&trackReq, db, S2_TRACKTYPE, trackedTypes[i], NULL)) {
+                printf("S2_TRACKTYPE failed\n");
+                return 1;
+            }
+        }
+    }
+
+    if (multicasts) {
+        // The IPv6 groups go in as a range, with all nodes in the middle of it
+        static const UBYTE mdns[6] = {0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB};
+        static const UBYTE ipv6Low[6] = {0x33, 0x33, 0x00, 0x00, 0x00, 0x00}, ipv6High[6] = {0x33, 0x33, 0x00, 0x00, 0x00, 0x03};
+        static const UBYTE stp[6] = {0x01, 0x80, 0xC2, 0x00, 0x00, 0x00};
+        struct IOSana2Req mcastReq = openReq;
+        BYTE error = multicastCommand(&mcastReq, db, S2_ADDMULTICASTADDRESS, mdns, NULL);
+        if (!error) error = multicastCommand(&mcastReq, db, S2_ADDMULTICASTADDRESSES, ipv6Low, ipv6High);
+        if (!error) error = multicastCommand(&mcastReq, db, S2_ADDMULTICASTADDRESS, stp, NULL);
+        // Let frame_proc pass them on before spanning tree is taken out of the driver's table again
+        Delay(5);
+        if (!error) error = multicastCommand(&mcastReq, db, S2_DELMULTICASTADDRESS, stp, NULL);
+        if ((!error) && (multicastCommand(&mcastReq, db, S2_DELMULTICASTADDRESS, stp, NULL) != S2ERR_BAD_ADDRESS)) error = -1;
+        if (error) {
+            printf("Multicast commands failed (%d)\n", error);
+            return 1;
+        }
+    }
+
+    // A little timer so we don't hang if the driver stops replying
+    struct timerequest* tick = CreateIORequest(port, sizeof(struct timerequest));
+    OpenDevice(TIMERNAME, UNIT_MICROHZ, (struct IORequest*)tick, 0);
+
+    // Post reads the way Roadshow does: several for IP, a couple for everything else
+    static struct BenchRequest requests[MAX_REQUESTS];
+    int total = 0;
+    for (int i = 0; i < reads; i++, total++) {
+        requests[total].req = openReq;
+        requests[total].isWrite = FALSE;
+        requests[total].req.ios2_PacketType = (i < reads - 4) ? ETHERTYPE_IPV4 : ((i & 1) ? ETHERTYPE_ARP : ETHERTYPE_IPV6);
+    }
+    for (int i = 0; i < writes; i++, total++) {
+        requests[total].req = openReq;
+        requests[total].isWrite = TRUE;
+        requests[total].req.ios2_PacketType = ETHERTYPE_IPV4;
+    }
+
+    // Watch the run with S2_SAMPLE_THROUGHPUT the way a network monitor would.  It's
+    // replied on its own port so it doesn't get mixed up with the reads and writes
+    struct MsgPort* samplePort = CreateMsgPort();
+    struct Sana2ThroughputStats sample;
+    struct IOSana2Req sampleReq = openReq;
+    memset(&sample, 0, sizeof(sample));
+    sample.s2ts_Length = sizeof(sample);
+    sampleReq.ios2_Req.io_Message.mn_ReplyPort = samplePort;
+    sampleReq.ios2_Req.io_Command = S2_SAMPLE_THROUGHPUT;
+    sampleReq.ios2_Req.io_Flags = 0;
+    sampleReq.ios2_StatData = &sample;
+    DevBeginIO(&sampleReq, db);
+
+    // Traced the way tracedump does it, through its own unit alongside the stack
+    static struct IOSana2Req traceReq;
+    if (traceFile) {
+        traceReq = openReq;
+        if (DevOpen(&traceReq, S2_DAYNA_TRACE_UNIT, 0, db)) {
+            printf("WARNING: couldn't open the trace unit\n");
+            traceFile = NULL;
+        } else if (quickCommand(&traceReq, db, S2_DAYNA_TRACE, TRACE_CTRL_CLEAR | TRACE_CTRL_START, NULL)) {
+            printf("WARNING: S2_DAYNA_TRACE failed, rebuild with trace=1 to use -D\n");
+            traceFile = NULL;
+        }
+    }
+
+    struct HostShimStats startStats = HostShim_Stats;
+    struct DaynaTarget_Stats startTarget = target.stats;
+    ULONG startTxCommands = db->db_TxCommands;
+    ULONG startRxDropped = db->db_RxDropped, startOverruns = db->db_DevStats.Overruns, startRxFiltered = db->db_RxFiltered, startMcastDropped = db->db_MulticastDropped;
+    ULONG startNotOurs = db->db_RxNotOurs, startPromiscuous = db->db_RxPromiscuous;
+    ULONG startTxBatch[SCSIWIFI_TX_BATCH_MAX + 1];
+    memcpy(startTxBatch, db->db_TxBatchFrames, sizeof(startTxBatch));
+    bench.startTime = HostShim_Micros();
+    traffic.bulkEnabled = (bench.mode == bmDownload);
+    traffic.bulkRate = bench.packetsPerSecond;
+    traffic.bulkSize = bench.frameSize;
+    DaynaTarget_SetTraffic(&target, &traffic);
+    uint64_t endTime = bench.startTime + (uint64_t)seconds * 1000000ULL;
+    ULONG ackCredit = 0;
+    int outstanding = 0;
+
+    // Waits for the link to go, then for it to come back
+    struct IOSana2Req eventReq = openReq;
+    if (linkDropAt) {
+        eventReq.ios2_Req.io_Command = S2_ONEVENT;
+        eventReq.ios2_Req.io_Flags = 0;
+        eventReq.ios2_WireError = S2EVENT_OFFLINE;
+        DevBeginIO(&eventReq, db);
+    }
+
+    for (int i = 0; i < total; i++) {
+        // Downloads only write as ACKs are due
+        if ((requests[i].isWrite) && (bench.mode != bmUpload)) continue;
+        postRequest(&requests[i], db);
+        outstanding++;
+    }
+
+    tick->tr_node.io_Command = TR_ADDREQUEST;
+    tick->tr_time.tv_secs = 0;
+    tick->tr_time.tv_micro = tickMicros();
+    SendIO((struct IORequest*)tick);
+
+    while (HostShim_Micros() < endTime) {
+        struct Message* msg;
+        WaitPort(port);
+        while ((msg = GetMsg(port))) {
+            if (msg == (struct Message*)tick) {
+                tick->tr_time.tv_secs = 0;
+                tick->tr_time.tv_micro = tickMicros();
+                SendIO((struct IORequest*)tick);
+                if ((linkDropAt) && (!bench.linkDropped) && (HostShim_Micros() >= bench.startTime + (uint64_t)linkDropAt * 1000000ULL)) {
+                    pthread_mutex_lock(&target.lock);
+                    target.rssi = 0;
+                    pthread_mutex_unlock(&target.lock);
+                    bench.linkDropped = HostShim_Micros();
+                } else if ((bench.linkDropped) && (!bench.linkRestored) && (HostShim_Micros() >= bench.linkDropped + LINK_DROP_SECONDS * 1000000ULL)) {
+                    pthread_mutex_lock(&target.lock);
+                    target.rssi = -50;
+                    pthread_mutex_unlock(&target.lock);
+                    bench.linkRestored = HostShim_Micros();
+                }
+                // Pings go out on the tick, like keypresses in a telnet session
+                if (bench.mode == bmPing) {
+                    for (int i = reads; i < total; i++) {
+                        if (!requests[i].inFlight) {
+                            postRequest(&requests[i], db);
+                            outstanding++;
+                            break;
+                        }
+                    }
+                }
+                continue;
+            }
+            if (msg == (struct Message*)&eventReq) {
+                if (eventReq.ios2_WireError & S2EVENT_OFFLINE) {
+                    bench.offlineAfter = HostShim_Micros() - bench.linkDropped;
+                    eventReq.ios2_WireError = S2EVENT_ONLINE;
+                    DevBeginIO(&eventReq, db);
+                } else {
+                    bench.onlineAfter = HostShim_Micros() - bench.linkRestored;
+                    // Everything that failed while it was down goes again
+                    for (int i = 0; i < total; i++) {
+                        if ((requests[i].inFlight) || ((requests[i].isWrite) && (bench.mode != bmUpload))) continue;
+                        postRequest(&requests[i], db);
+                        outstanding++;
+                    }
+                }
+                continue;
+            }
+            struct BenchRequest* br = (struct BenchRequest*)msg;
+            br->inFlight = FALSE;
+            outstanding--;
+            // While the link's down failures wait for it to come back, rather than going straight round again
+            if ((br->req.ios2_Req.io_Error) && (bench.linkDropped) && (!bench.onlineAfter)) {
+                if (br->isWrite) bench.writeErrors++; else bench.readErrors++;
+                continue;
+            }
+            if (br->isWrite) {
+                if (br->req.ios2_Req.io_Error) bench.writeErrors++; else {
+                    bench.writesDone++;
+                    bench.writeBytes += br->req.ios2_DataLength + (bench.rawWrites ? 0 : HW_ETH_HDR_SIZE);
+                }
+                if (bench.mode == bmUpload) {
+                    postRequest(br, db);
+                    outstanding++;
+                }
+            } else {
+                if (br->req.ios2_Req.io_Error) bench.readErrors++; else {
+                    bench.readsDone++;
+                    bench.readBytes += br->req.ios2_DataLength + HW_ETH_HDR_SIZE;
+                    // Only the echoes carry a stamp, not ARP or storm traffic that came in alongside them
+                    if ((bench.mode == bmPing) && (br->req.ios2_PacketType == ETHERTYPE_IPV4) &&
+                        (memcmp(br->req.ios2_DstAddr, bench.stationMac, 6) == 0)) {
+                        uint64_t arrived;
+                        memcpy(&arrived, br->buffer, sizeof(arrived));
+                        uint64_t latency = HostShim_Micros() - arrived;
+                        bench.latencyTotal += latency;
+                        if (latency > bench.latencyMax) bench.latencyMax = latency;
+                        bench.latencyCount++;
+                    }
+                    // TCP receivers ACK every second segment
+                    if ((bench.mode == bmDownload) && ((++ackCredit & 1) == 0)) {
+                        for (int i = reads; i < total; i++) {
+                            if (!requests[i].inFlight) {
+                                postRequest(&requests[i], db);
+                                outstanding++;
+                                break;
+                            }
+                        }
+                    }
+                }
+                postRequest(br, db);
+                outstanding++;
+            }
+        }
+    }
+    double elapsed = (double)(HostShim_Micros() - bench.startTime) / 1000000.0;
+    struct HostShimStats endStats = HostShim_Stats;
+    if ((linkDropAt) && (!bench.onlineAfter) && (DevAbortIO((struct IORequest*)&eventReq, db) == 0)) GetMsg(port);
+    BOOL sampleOK = (DevAbortIO((struct IORequest*)&sampleReq, db) == 0);
+    WaitPort(samplePort);
+    GetMsg(samplePort);
+    DeleteMsgPort(samplePort);
+    static struct {
+        struct Sana2SpecialStatHeader header;
+        struct Sana2SpecialStatRecord records[128];
+    } special;
+    special.header.RecordCountMax = 128;
+    struct IOSana2Req specialReq = openReq;
+    quickCommand(&specialReq, db, S2_GETSPECIALSTATS, 0, &special);
+    struct Sana2ExtDeviceStats extStats;
+    memset(&extStats, 0, sizeof(extStats));
+    extStats.s2xds_Length = sizeof(extStats);
+    struct IOSana2Req extReq = openReq;
+    if (quickCommand(&extReq, db, S2_GETEXTENDEDGLOBALSTATS, 0, &extStats) || (extStats.s2xds_Actual != sizeof(extStats))) sampleOK = FALSE;
+    struct DaynaTarget_Stats endTarget = target.stats;
+    struct Sana2PacketTypeStats typeStats[TRACKED_TYPE_COUNT];
+    BOOL typeStatsOK = trackTypes;
+    if (trackTypes) {
+        struct IOSana2Req statReq = openReq;
+        for (int i = 0; i < TRACKED_TYPE_COUNT; i++) {
+            if (quickCommand(&statReq, db, S2_GETTYPESTATS, trackedTypes[i], &typeStats[i])) typeStatsOK = FALSE;
+        }
+        for (int i = 0; i < TRACKED_TYPE_COUNT; i++) quickCommand(&statReq, db, S2_UNTRACKTYPE, trackedTypes[i], NULL);
+        struct Sana2PacketTypeStats untracked;
+        if (quickCommand(&statReq, db, S2_GETTYPESTATS, ETHERTYPE_IPV4, &untracked) != S2ERR_BAD_STATE) typeStatsOK = FALSE;
+    }
+
+    if (traceFile) {
+        static UBYTE traceDump[sizeof(struct TraceDumpHeader) + TRACE_EVENTS * sizeof(struct TraceRecord)];
+        traceReq.ios2_Data = traceDump;
+        traceReq.ios2_DataLength = sizeof(traceDump);
+        FILE* f = NULL;
+        if (quickCommand(&traceReq, db, S2_DAYNA_TRACE, TRACE_CTRL_STOP | TRACE_CTRL_DUMP, NULL)) printf("WARNING: trace dump failed\n");
+        else if ((!(f = fopen(traceFile, "wb"))) || (fwrite(traceDump, 1, traceReq.ios2_DataLength, f) != traceReq.ios2_DataLength)) printf("WARNING: couldn't write %s\n", traceFile);
+        else printf("Trace: %lu events saved to %s\n", (unsigned long)((struct TraceDumpHeader*)traceDump)->th_Count, traceFile);
+        if (f) fclose(f);
+    }
+
+    // Closing stops frame_proc, which hands back anything still queued.  Give
+    // it a second, and report anything that never came back
+    DevClose((struct IORequest*)&openReq, db);
+    if (traceReq.ios2_Req.io_Device) DevClose((struct IORequest*)&traceReq, db);
+    uint64_t drainEnd = HostShim_Micros() + 1000000ULL;
+    while ((outstanding > 0) && (HostShim_Micros() < drainEnd)) {
+        struct Message* msg;
+        WaitPort(port);
+        while ((msg = GetMsg(port))) {
+            if (msg == (struct Message*)tick) {
+                tick->tr_time.tv_secs = 0;
+                tick->tr_time.tv_micro = 100000;
+                SendIO((struct IORequest*)tick);
+            } else outstanding--;
+        }
+    }
+    ULONG txCommands = db->db_TxCommands - startTxCommands;
+    ULONG txBatch[SCSIWIFI_TX_BATCH_MAX + 1];
+    for (int i = 0; i <= SCSIWIFI_TX_BATCH_MAX; i++) txBatch[i] = db->db_TxBatchFrames[i] - startTxBatch[i];
+    AbortIO((struct IORequest*)tick);
+    WaitIO((struct IORequest*)tick);
+    CloseDevice((struct IORequest*)tick);
+    DeleteIORequest(tick);
+    DeleteMsgPort(port);
+    // A lingering frame_proc is told to go by the first expunge, which leaves the rest for the next
+    for (int i = 0; (i < 250) && (db->db_Proc); i++) {
+        DevExpunge(db);
+        Delay(1);
+    }
+
+    ULONG frames = bench.readsDone + bench.writesDone;
+    ULONG commands = endStats.scsiCommands - startStats.scsiCommands;
+    static const char* modeNames[] = {"download", "upload", "idle", "ping"};
+
+    printf("frame_proc benchmark: %s, %d byte frames, SCSI MODE=%d%s, controller %s with %s, %.2f s\n", modeNames[bench.mode], (int)bench.frameSize,
+           (int)db->db_scsiMode, (scsiMode < 0) ? " (auto)" : "", timing->name, driverName ? driverName : timing->driverName, elapsed);
+    printf("  DevInit: %.1f ms, found the DaynaPORT on ID %d\n", initMillis, (int)db->db_scsiDeviceID);
+    if (reopen) printf("  Reopen: link back after %.1f ms, %lu INQUIRYs, S2_ONEVENT %s by the close\n", reopenMillis, (unsigned long)reopenInquiries,
+                       closeAborted ? "aborted" : "NOT aborted");
+    if (linkDropAt) {
+        if (!bench.offlineAfter) printf("  Link drop: S2EVENT_OFFLINE never came\n");
+        else if (!bench.onlineAfter) printf("  Link drop: S2EVENT_OFFLINE after %.0f ms, S2EVENT_ONLINE never came\n", bench.offlineAfter / 1000.0);
+        else printf("  Link drop: S2EVENT_OFFLINE after %.0f ms, S2EVENT_ONLINE %.0f ms after it came back\n", bench.offlineAfter / 1000.0, bench.onlineAfter / 1000.0);
+    }
+    printf("  RX: %9lu frames %10.0f frames/s %12.0f bytes/s  (%lu errors)\n", (unsigned long)bench.readsDone, bench.readsDone / elapsed, bench.readBytes / elapsed, (unsigned long)bench.readErrors);
+    printf("  TX: %9lu frames %10.0f frames/s %12.0f bytes/s  (%lu errors)\n", (unsigned long)bench.writesDone, bench.writesDone / elapsed, bench.writeBytes / elapsed, (unsigned long)bench.writeErrors);
+    printf("  SCSI commands: %lu (%.0f/s), %.3f per frame\n", (unsigned long)commands, commands / elapsed, frames ? (double)commands / frames : 0.0);
+    for (int op = 0; op < 256; op++) {
+        ULONG count = endStats.scsiOpcodes[op] - startStats.scsiOpcodes[op];
+        if (!count) continue;
+        if (op == 0x1c) {
+            for (int sub = 0; sub < 256; sub++) {
+                ULONG subCount = endStats.scsiSubOpcodes[sub] - startStats.scsiSubOpcodes[sub];
+                if (subCount) printf("    0x1c/0x%02x: %lu\n", sub, (unsigned long)subCount);
+            }
+        } else printf("    0x%02x:      %lu\n", op, (unsigned long)count);
+    }
+    ULONG delivered = endTarget.framesReceived - startTarget.framesReceived;
+    printf("  DaynaPORT: %lu frames delivered, %lu not claimed by a CMD_READ\n", (unsigned long)delivered,
+           (unsigned long)((delivered > bench.readsDone) ? delivered - bench.readsDone : 0));
+    ULONG batched = endTarget.batchedReads - startTarget.batchedReads;
+    if (batched) printf("  DaynaPORT: %lu batched reads, %.2f frames each\n", (unsigned long)batched, (double)delivered / batched);
+    if (txCommands) {
+        ULONG txFrames = 0;
+        for (int i = 1; i <= SCSIWIFI_TX_BATCH_MAX; i++) txFrames += i * txBatch[i];
+        printf("  TX batches: %lu WRITE FRAMEs, %.2f frames each, %lu commands saved, sizes", (unsigned long)txCommands,
+               (double)txFrames / txCommands, (unsigned long)(txFrames - txCommands));
+        for (int i = 1; i <= SCSIWIFI_TX_BATCH_MAX; i++) printf(" %d:%lu", i, (unsigned long)txBatch[i]);
+        printf("\n");
+    }
+    ULONG batchedWrites = endTarget.batchedWrites - startTarget.batchedWrites;
+    if (batchedWrites) printf("  DaynaPORT: %lu batched writes\n", (unsigned long)batchedWrites);
+    printf("  DaynaPORT: %lu frames arrived, %lu overrun the %d slot buffer, %lu filtered\n",
+           (unsigned long)(endTarget.framesArrived - startTarget.framesArrived),
+           (unsigned long)(endTarget.framesOverrun - startTarget.framesOverrun), slots,
+           (unsigned long)(endTarget.framesFiltered - startTarget.framesFiltered));
+    if (timing->commandMicros)
+        printf("  SCSI bus busy %.1f%%, CPU moving data (PIO) %.1f%%\n",
+               (double)(endTarget.busMicros - startTarget.busMicros) / (elapsed * 10000.0),
+               (double)(endTarget.cpuMicros - startTarget.cpuMicros) / (elapsed * 10000.0));
+    if (bench.latencyCount)
+        printf("  Latency, echo arrival to CMD_READ reply: %.2f ms average, %.2f ms worst\n",
+               (double)bench.latencyTotal / bench.latencyCount / 1000.0, (double)bench.latencyMax / 1000.0);
+    if (aligned) printf("  Stack copies: %lu, of which %lu 16 bit and %lu 32 bit\n", (unsigned long)bench.copies,
+                        (unsigned long)bench.alignedCopies[0], (unsigned long)bench.alignedCopies[1]);
+    printf("  Frames dropped: %lu, receive pool overruns: %lu\n", (unsigned long)(db->db_RxDropped - startRxDropped),
+           (unsigned long)(db->db_DevStats.Overruns - startOverruns));
+    if (filter) printf("  Packet filter: %lu frames checked, %lu rejected\n", (unsigned long)bench.filterCalls,
+                       (unsigned long)(db->db_RxFiltered - startRxFiltered));
+    printf("  Frames for other stations dropped: %lu, passed on only as promiscuous: %lu\n", (unsigned long)(db->db_RxNotOurs - startNotOurs),
+           (unsigned long)(db->db_RxPromiscuous - startPromiscuous));
+    if (multicasts) printf("  Multicasts to groups left: %lu dropped by the driver\n", (unsigned long)(db->db_MulticastDropped - startMcastDropped));
+    printf("  Empty reads: %lu, timer requests: %lu, blocking waits: %lu, allocations: %lu\n",
+           (unsigned long)(endTarget.emptyReads - startTarget.emptyReads),
+           (unsigned long)(endStats.timerRequests - startStats.timerRequests),
+           (unsigned long)(endStats.waits - startStats.waits),
+           (unsigned long)(endStats.allocs - startStats.allocs));
+    if (!sampleOK) printf("  WARNING: S2_SAMPLE_THROUGHPUT or S2_GETEXTENDEDGLOBALSTATS didn't behave\n"); else {
+        double sampled = (double)(sample.s2ts_EndTime.tv_secs - sample.s2ts_StartTime.tv_secs) +
+                         ((double)sample.s2ts_EndTime.tv_micro - (double)sample.s2ts_StartTime.tv_micro) / 1000000.0;
+        if (sampled > 0) printf("  Sampled: RX %.0f bytes/s, TX %.0f bytes/s over %.2f s, %lu updates; %lu received, %lu sent in all\n",
+                                sample.s2ts_BytesReceived.s2q_Low / sampled, sample.s2ts_BytesSent.s2q_Low / sampled, sampled,
+                                (unsigned long)sample.s2ts_Updates.s2q_Low, (unsigned long)extStats.s2xds_PacketsReceived.s2q_Low,
+                                (unsigned long)extStats.s2xds_PacketsSent.s2q_Low);
+    }
+    if (histograms) {
+        // Each histogram bucket is a record, the EClock rate converts them to time
+        ULONG eclock = 0;
+        for (ULONG i = 0; i < special.header.RecordCountSupplied; i++) {
+            struct Sana2SpecialStatRecord* r = &special.records[i];
+            if (r->Type == S2SS_DAYNA_ECLOCK) eclock = r->Count; else
+            if (r->Type < S2SS_DAYNA_HISTOGRAM(0, 0)) printf("  %s: %ld\n", r->String, (long)(LONG)r->Count);
+        }
+        for (int h = 0; (h < shCount) && (eclock); h++) {
+            const char* name = NULL;
+            for (ULONG i = 0; i < special.header.RecordCountSupplied; i++) {
+                struct Sana2SpecialStatRecord* r = &special.records[i];
+                if ((r->Type & ~0x0F) != S2SS_DAYNA_HISTOGRAM(h, 0)) continue;
+                if (!name) {
+                    name = r->String;
+                    printf("  %.*s:", (int)(strchr(name, ',') - name), name);
+                }
+                if (!r->Count) continue;
+                ULONG bucket = r->Type & 0x0F;
+                if (bucket == SCSIWIFI_HISTOGRAM_BUCKETS - 1) printf(" rest:%lu", (unsigned long)r->Count);
+                else printf(" <%.0fus:%lu", (double)(1UL << (bucket + SCSIWIFI_HISTOGRAM_SHIFT)) * 1000000.0 / eclock, (unsigned long)r->Count);
+            }
+            printf("\n");
+        }
+    }
+    if (trackTypes) {
+        if (!typeStatsOK) printf("  WARNING: S2_GETTYPESTATS didn't behave\n");
+        else for (int i = 0; i < TRACKED_TYPE_COUNT; i++) {
+            printf("  Type 0x%04x: RX %lu frames %lu bytes, TX %lu frames %lu bytes, %lu dropped\n", trackedTypes[i],
+                   (unsigned long)typeStats[i].PacketsReceived, (unsigned long)typeStats[i].BytesReceived,
+                   (unsigned long)typeStats[i].PacketsSent, (unsigned long)typeStats[i].BytesSent,
+                   (unsigned long)typeStats[i].PacketsDropped);
+        }
+    }
+    if (outstanding > 0) printf("  WARNING: %d requests were still queued after DevClose\n", outstanding);
+    // The report's done with the device base, which this frees
+    DevExpunge(db);
+
+    char path[600];
+    snprintf(path, sizeof(path), "%s/scsidayna.prefs", envDir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/scsidayna.detected", envDir);
+    unlink(path);
+    rmdir(envDir);
+    return 0;
+}
@@ -0,0 +1,570 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support
+ *
+ * This is a *very* thin stand-in for the parts of the AmigaOS NDK that
+ * device.c and scsiwifi.c use, so that the unmodified driver sources can be
+ * compiled and profiled on a normal PC.  Only what the driver needs is here,
+ * and Exec's behaviour (signals, message ports, semaphores, IO) is emulated
+ * with pthreads.  None of this is used for the real m68k build.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+#ifndef AMIGA_HOST_H
+#define AMIGA_HOST_H 1
+
+// Pull in the C library first.  glibc declares its own struct timeval, which
+// would clash with the timer.device one below, so make sure that's out of the
+// way before we rename ours.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#define timeval amiga_timeval
+
+// vbcc/SAS keywords used directly in the driver sources
+#define __saveds
+#define __reg(x)
+
+/****************************************************************************/
+/* exec/types.h                                                             */
+/****************************************************************************/
+
+typedef uint32_t        ULONG;
+typedef int32_t         LONG;
+typedef uint16_t        UWORD;
+typedef int16_t         WORD;
+typedef uint16_t        USHORT;
+typedef int16_t         SHORT;
+typedef uint8_t         UBYTE;
+typedef int8_t          BYTE;
+typedef short           BOOL;
+typedef void*           APTR;
+typedef char*           STRPTR;
+typedef const char*     CONST_STRPTR;
+typedef unsigned char   TEXT;
+typedef void            VOID;
+// Pointer sized integer, as per AROS. Tag data and BPTRs have to hold host pointers
+typedef uintptr_t       IPTR;
+typedef intptr_t        SIPTR;
+typedef intptr_t        BPTR;
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+#ifndef CONST
+#define CONST const
+#endif
+
+/****************************************************************************/
+/* exec/nodes.h, exec/lists.h                                               */
+/****************************************************************************/
+
+struct Node {
+    struct Node* ln_Succ;
+    struct Node* ln_Pred;
+    UBYTE        ln_Type;
+    BYTE         ln_Pri;
+    char*        ln_Name;
+};
+
+struct MinNode {
+    struct MinNode* mln_Succ;
+    struct MinNode* mln_Pred;
+};
+
+#define NT_UNKNOWN      0
+#define NT_TASK         1
+#define NT_INTERRUPT    2
+#define NT_DEVICE       3
+#define NT_MSGPORT      4
+#define NT_MESSAGE      5
+#define NT_FREEMSG      6
+#define NT_REPLYMSG     7
+#define NT_RESOURCE     8
+#define NT_LIBRARY      9
+#define NT_SEMAPHORE    15
+#define NT_PROCESS      13
+
+struct List {
+    struct Node* lh_Head;
+    struct Node* lh_Tail;
+    struct Node* lh_TailPred;
+    UBYTE        lh_Type;
+    UBYTE        l_pad;
+};
+
+struct MinList {
+    struct MinNode* mlh_Head;
+    struct MinNode* mlh_Tail;
+    struct MinNode* mlh_TailPred;
+};
+
+#define IsListEmpty(x) (((x)->lh_TailPred) == (struct Node *)(x))
+
+/****************************************************************************/
+/* exec/libraries.h, exec/devices.h, exec/resident.h                        */
+/****************************************************************************/
+
+struct Library {
+    struct Node lib_Node;
+    UBYTE       lib_Flags;
+    UBYTE       lib_pad;
+    UWORD       lib_NegSize;
+    UWORD       lib_PosSize;
+    UWORD       lib_Version;
+    UWORD       lib_Revision;
+    APTR        lib_IdString;
+    ULONG       lib_Sum;
+    UWORD       lib_OpenCnt;
+};
+
+#define LIBF_SUMMING    (1<<0)
+#define LIBF_CHANGED    (1<<1)
+#define LIBF_SUMUSED    (1<<2)
+#define LIBF_DELEXP     (1<<3)
+
+/****************************************************************************/
+/* exec/ports.h                                                             */
+/****************************************************************************/
+
+struct MsgPort {
+    struct Node mp_Node;
+    UBYTE       mp_Flags;
+    UBYTE       mp_SigBit;
+    void*       mp_SigTask;
+    struct List mp_MsgList;
+};
+
+#define PF_ACTION   3
+#define PA_SIGNAL   0
+#define PA_SOFTINT  1
+#define PA_IGNORE   2
+
+struct Message {
+    struct Node     mn_Node;
+    struct MsgPort* mn_ReplyPort;
+    UWORD           mn_Length;
+};
+
+/****************************************************************************/
+/* exec/tasks.h, exec/semaphores.h, exec/execbase.h                         */
+/****************************************************************************/
+
+struct Task {
+    struct Node tc_Node;
+    UBYTE       tc_Flags;
+    UBYTE       tc_State;
+    BYTE        tc_IDNestCnt;
+    BYTE        tc_TDNestCnt;
+    ULONG       tc_SigAlloc;
+    ULONG       tc_SigWait;
+    ULONG       tc_SigRecvd;
+    ULONG       tc_SigExcept;
+    APTR        tc_UserData;
+    // Host only - the thread backing this task
+    pthread_cond_t tc_HostCond;
+    pthread_t      tc_HostThread;
+};
+
+#define SIGB_ABORT      0
+#define SIGB_CHILD      1
+#define SIGB_BLIT       4
+#define SIGB_SINGLE     4
+#define SIGB_INTUITION  5
+#define SIGB_NET        7
+#define SIGB_DOS        8
+
+#define SIGF_ABORT      (1UL<<SIGB_ABORT)
+#define SIGF_CHILD      (1UL<<SIGB_CHILD)
+#define SIGF_SINGLE     (1UL<<SIGB_SINGLE)
+#define SIGF_DOS        (1UL<<SIGB_DOS)
+
+struct SemaphoreRequest {
+    struct MinNode sr_Link;
+    struct Task*   sr_Waiter;
+};
+
+struct SignalSemaphore {
+    struct Node   ss_Link;
+    WORD          ss_NestCount;
+    struct Task*  ss_Owner;
+    // Host only
+    pthread_mutex_t ss_HostMutex;
+};
+
+struct ExecBase {
+    struct Library LibNode;
+    UWORD          SoftVer;
+    UWORD          AttnFlags;
+    ULONG          VBlankFrequency;
+    ULONG          PowerSupplyFrequency;
+    ULONG          ex_EClockFrequency;
+};
+
+#define AFB_68010   0
+#define AFB_68020   1
+#define AFB_68030   2
+#define AFB_68040   3
+#define AFF_68010   (1<<AFB_68010)
+#define AFF_68020   (1<<AFB_68020)
+#define AFF_68030   (1<<AFB_68030)
+#define AFF_68040   (1<<AFB_68040)
+
+/****************************************************************************/
+/* exec/io.h, exec/errors.h                                                 */
+/****************************************************************************/
+
+struct Device {
+    struct Library dd_Library;
+};
+
+struct Unit {
+    struct MsgPort unit_MsgPort;
+    UBYTE          unit_flags;
+    UBYTE          unit_pad;
+    UWORD          unit_OpenCnt;
+};
+
+struct IORequest {
+    struct Message  io_Message;
+    struct Device*  io_Device;
+    struct Unit*    io_Unit;
+    UWORD           io_Command;
+    UBYTE           io_Flags;
+    BYTE            io_Error;
+};
+
+struct IOStdReq {
+    struct Message  io_Message;
+    struct Device*  io_Device;
+    struct Unit*    io_Unit;
+    UWORD           io_Command;
+    UBYTE           io_Flags;
+    BYTE            io_Error;
+    ULONG           io_Actual;
+    ULONG           io_Length;
+    APTR            io_Data;
+    ULONG           io_Offset;
+};
+
+#define IOB_QUICK       0
+#define IOF_QUICK       (1<<0)
+
+#define CMD_INVALID     0
+#define CMD_RESET       1
+#define CMD_READ        2
+#define CMD_WRITE       3
+#define CMD_UPDATE      4
+#define CMD_CLEAR       5
+#define CMD_STOP        6
+#define CMD_START       7
+#define CMD_FLUSH       8
+#define CMD_NONSTD      9
+
+#define IOERR_OPENFAIL      (-1)
+#define IOERR_ABORTED       (-2)
+#define IOERR_NOCMD         (-3)
+#define IOERR_BADLENGTH     (-4)
+#define IOERR_BADADDRESS    (-5)
+#define IOERR_UNITBUSY      (-6)
+#define IOERR_SELFTEST      (-7)
+
+/****************************************************************************/
+/* exec/memory.h                                                            */
+/****************************************************************************/
+
+#define MEMF_ANY        (0L)
+#define MEMF_PUBLIC     (1L<<0)
+#define MEMF_CHIP       (1L<<1)
+#define MEMF_FAST       (1L<<2)
+#define MEMF_24BITDMA   (1L<<9)
+#define MEMF_CLEAR      (1L<<16)
+
+/****************************************************************************/
+/* utility/tagitem.h, utility/hooks.h                                       */
+/****************************************************************************/
+
+typedef ULONG Tag;
+
+struct TagItem {
+    Tag  ti_Tag;
+    IPTR ti_Data;
+};
+
+#define TAG_DONE    (0L)
+#define TAG_END     (0L)
+#define TAG_IGNORE  (1L)
+#define TAG_MORE    (2L)
+#define TAG_SKIP    (3L)
+#define TAG_USER    ((ULONG)(1UL<<31))
+
+struct Hook {
+    struct MinNode h_MinNode;
+    IPTR           (*h_Entry)();
+    IPTR           (*h_SubEntry)();
+    APTR           h_Data;
+};
+
+/****************************************************************************/
+/* devices/timer.h                                                          */
+/****************************************************************************/
+
+#define UNIT_MICROHZ    0
+#define UNIT_VBLANK     1
+#define UNIT_ECLOCK     2
+#define UNIT_WAITUNTIL  3
+#define UNIT_WAITECLOCK 4
+
+#define TIMERNAME       "timer.device"
+
+struct timeval {
+    ULONG tv_secs;
+    ULONG tv_micro;
+};
+
+struct EClockVal {
+    ULONG ev_hi;
+    ULONG ev_lo;
+};
+
+struct timerequest {
+    struct IORequest tr_node;
+    struct timeval   tr_time;
+};
+
+#define TR_ADDREQUEST   CMD_NONSTD
+#define TR_GETSYSTIME   (CMD_NONSTD+1)
+#define TR_SETSYSTIME   (CMD_NONSTD+2)
+
+/****************************************************************************/
+/* devices/scsidisk.h                                                       */
+/****************************************************************************/
+
+#define HD_SCSICMD      28
+
+struct SCSICmd {
+    UWORD* scsi_Data;
+    ULONG  scsi_Length;
+    ULONG  scsi_Actual;
+    UBYTE* scsi_Command;
+    UWORD  scsi_CmdLength;
+    UWORD  scsi_CmdActual;
+    UBYTE  scsi_Flags;
+    UBYTE  scsi_Status;
+    UBYTE* scsi_SenseData;
+    UWORD  scsi_SenseLength;
+    UWORD  scsi_SenseActual;
+};
+
+#define SCSIF_WRITE         0
+#define SCSIF_READ          1
+#define SCSIB_READ_WRITE    0
+#define SCSIF_NOSENSE       0
+#define SCSIF_AUTOSENSE     2
+#define SCSIF_OLDAUTOSENSE  6
+#define SCSIB_AUTOSENSE     1
+
+#define HFERR_SelfUnit      40
+#define HFERR_DMA           41
+#define HFERR_Phase         42
+#define HFERR_Parity        43
+#define HFERR_SelTimeout    44
+#define HFERR_BadStatus     45
+#define HFERR_NoBoard       50
+
+/****************************************************************************/
+/* dos/dos.h, dos/dosextens.h, dos/dostags.h                                */
+/****************************************************************************/
+
+#define MODE_OLDFILE        1005
+#define MODE_NEWFILE        1006
+#define MODE_READWRITE      1004
+
+#define SIGBREAKB_CTRL_C    12
+#define SIGBREAKB_CTRL_D    13
+#define SIGBREAKB_CTRL_E    14
+#define SIGBREAKB_CTRL_F    15
+#define SIGBREAKF_CTRL_C    (1UL<<SIGBREAKB_CTRL_C)
+#define SIGBREAKF_CTRL_D    (1UL<<SIGBREAKB_CTRL_D)
+#define SIGBREAKF_CTRL_E    (1UL<<SIGBREAKB_CTRL_E)
+#define SIGBREAKF_CTRL_F    (1UL<<SIGBREAKB_CTRL_F)
+
+#define GVF_GLOBAL_ONLY     (1L<<8)
+#define GVF_LOCAL_ONLY      (1L<<9)
+
+struct Process {
+    struct Task    pr_Task;
+    struct MsgPort pr_MsgPort;
+    WORD           pr_Pad;
+    BPTR           pr_SegList;
+    LONG           pr_StackSize;
+    APTR           pr_GlobVec;
+    LONG           pr_TaskNum;
+    BPTR           pr_StackBase;
+    LONG           pr_Result2;
+};
+
+#define NP_Dummy        (TAG_USER + 1000)
+#define NP_Seglist      (NP_Dummy + 1)
+#define NP_FreeSeglist  (NP_Dummy + 2)
+#define NP_Entry        (NP_Dummy + 3)
+#define NP_Input        (NP_Dummy + 4)
+#define NP_Output       (NP_Dummy + 5)
+#define NP_CloseInput   (NP_Dummy + 6)
+#define NP_CloseOutput  (NP_Dummy + 7)
+#define NP_Error        (NP_Dummy + 8)
+#define NP_CloseError   (NP_Dummy + 9)
+#define NP_CurrentDir   (NP_Dummy + 10)
+#define NP_StackSize    (NP_Dummy + 11)
+#define NP_Name         (NP_Dummy + 12)
+#define NP_Priority     (NP_Dummy + 13)
+
+/****************************************************************************/
+/* Function prototypes (exec, amiga.lib, utility, dos, timer)               */
+/*                                                                          */
+/* Library bases are accepted by the driver macros but never dereferenced,  */
+/* so none of these take one.                                               */
+/****************************************************************************/
+
+// exec lists
+void         NewList(struct List* list);
+void         AddHead(struct List* list, struct Node* node);
+void         AddTail(struct List* list, struct Node* node);
+void         Remove(struct Node* node);
+struct Node* RemHead(struct List* list);
+struct Node* RemTail(struct List* list);
+void         Enqueue(struct List* list, struct Node* node);
+void         Insert(struct List* list, struct Node* node, struct Node* pred);
+struct Node* FindName(struct List* list, CONST_STRPTR name);
+
+// exec memory
+APTR  AllocMem(ULONG byteSize, ULONG requirements);
+void  FreeMem(APTR memoryBlock, ULONG byteSize);
+APTR  AllocVec(ULONG byteSize, ULONG requirements);
+void  FreeVec(APTR memoryBlock);
+
+// exec tasks and signals
+struct Task* FindTask(CONST_STRPTR name);
+BYTE  SetTaskPri(struct Task* task, LONG priority);
+BYTE  AllocSignal(LONG signalNum);
+void  FreeSignal(LONG signalNum);
+ULONG SetSignal(ULONG newSignals, ULONG signalSet);
+ULONG Wait(ULONG signalSet);
+void  Signal(struct Task* task, ULONG signalSet);
+void  Forbid(void);
+void  Permit(void);
+void  Disable(void);
+void  Enable(void);
+
+// exec semaphores
+void  InitSemaphore(struct SignalSemaphore* sigSem);
+void  ObtainSemaphore(struct SignalSemaphore* sigSem);
+ULONG AttemptSemaphore(struct SignalSemaphore* sigSem);
+void  ReleaseSemaphore(struct SignalSemaphore* sigSem);
+
+// exec messages
+struct MsgPort* CreateMsgPort(void);
+void            DeleteMsgPort(struct MsgPort* port);
+void            AddPort(struct MsgPort* port);
+void            RemPort(struct MsgPort* port);
+void            PutMsg(struct MsgPort* port, struct Message* message);
+struct Message* GetMsg(struct MsgPort* port);
+void            ReplyMsg(struct Message* message);
+struct Message* WaitPort(struct MsgPort* port);
+
+// exec IO
+APTR              CreateIORequest(struct MsgPort* port, ULONG size);
+void              DeleteIORequest(APTR iorequest);
+BYTE              OpenDevice(CONST_STRPTR devName, ULONG unit, struct IORequest* ioRequest, ULONG flags);
+void              CloseDevice(struct IORequest* ioRequest);
+BYTE              DoIO(struct IORequest* ioRequest);
+void              SendIO(struct IORequest* ioRequest);
+void              BeginIO(struct IORequest* ioRequest);
+struct IORequest* CheckIO(struct IORequest* ioRequest);
+BYTE              WaitIO(struct IORequest* ioRequest);
+void              AbortIO(struct IORequest* ioRequest);
+
+// exec libraries
+struct Library* OpenLibrary(CONST_STRPTR libName, ULONG version);
+void            CloseLibrary(struct Library* library);
+
+// utility.library
+IPTR            GetTagData(Tag tagValue, IPTR defaultVal, const struct TagItem* tagList);
+struct TagItem* FindTagItem(Tag tagValue, const struct TagItem* tagList);
+struct TagItem* NextTagItem(struct TagItem** tagListPtr);
+LONG            Stricmp(CONST_STRPTR string1, CONST_STRPTR string2);
+LONG            Strnicmp(CONST_STRPTR string1, CONST_STRPTR string2, LONG length);
+UBYTE           ToUpper(ULONG character);
+IPTR            CallHookPkt(struct Hook* hook, APTR object, APTR message);
+
+// dos.library
+BPTR            Open(CONST_STRPTR name, LONG accessMode);
+LONG            Close(BPTR file);
+LONG            Read(BPTR file, APTR buffer, LONG length);
+LONG            Write(BPTR file, CONST APTR buffer, LONG length);
+STRPTR          FGets(BPTR fh, STRPTR buf, ULONG len);
+LONG            FPuts(BPTR fh, CONST_STRPTR str);
+LONG            DeleteFile(CONST_STRPTR name);
+void            Delay(LONG timeout);
+LONG            GetVar(CONST_STRPTR name, STRPTR buffer, LONG size, LONG flags);
+struct Process* CreateNewProcTagList(const struct TagItem* tags);
+struct Process* _host_CreateNewProcTags(int dummy, ...);
+#define CreateNewProcTags(...) _host_CreateNewProcTags(0, __VA_ARGS__)
+
+// timer.device
+void  GetSysTime(struct timeval* dest);
+ULONG ReadEClock(struct EClockVal* dest);
+void  AddTime(struct timeval* dest, struct timeval* src);
+void  SubTime(struct timeval* dest, struct timeval* src);
+LONG  CmpTime(struct timeval* dest, struct timeval* src);
+
+
+/****************************************************************************/
+/* Host side hooks                                                          */
+/****************************************************************************/
+
+// A SCSI "controller" registered with the shim. OpenDevice() of any device
+// name that isn't timer.device lands here, and every HD_SCSICMD on it is
+// handed to command().  command() should fill in scsi_Actual/scsi_Status/
+// scsi_SenseActual and return an io_Error value.  A PIO controller runs it
+// in the calling task, a DMA one queues it to its own task and replies when
+// it's done, so a caller using SendIO() can get on with something else.
+struct HostSCSIBackend {
+    // Return 0 if the unit (SCSI ID) should open OK, else an io_Error
+    BYTE (*open)(void* context, const char* deviceName, ULONG unit);
+    void (*close)(void* context, ULONG unit);
+    BYTE (*command)(void* context, ULONG unit, struct SCSICmd* cmd);
+    void* context;
+    BOOL dma;
+};
+
+// Install the backend used for every SCSI OpenDevice() call
+void HostSCSI_SetBackend(const struct HostSCSIBackend* backend);
+
+// Counters the shim keeps while running, for the benchmarks
+struct HostShimStats {
+    ULONG allocs;           // AllocMem/AllocVec calls
+    ULONG frees;            // FreeMem/FreeVec calls
+    ULONG scsiCommands;     // HD_SCSICMD requests issued
+    ULONG scsiOpcodes[256]; // ...by CDB opcode
+    ULONG scsiSubOpcodes[256]; // 0x1c sub-command breakdown
+    ULONG timerRequests;    // TR_ADDREQUEST requests issued
+    ULONG waits;            // Wait() calls that actually blocked
+};
+extern struct HostShimStats HostShim_Stats;
+
+// Monotonic time in microseconds, for the benchmarks
+uint64_t HostShim_Micros(void);
+
+// The directory used for ENV: and ENVARC: (defaults to the current directory,
+// or SCSIDAYNA_ENV / SCSIDAYNA_ENVARC if set)
+void HostShim_SetEnvDirs(const char* env, const char* envarc);
+
+#endif
@@ -0,0 +1,2 @@
+/* Host build: everything lives in amiga_host.h */
+#include "../amiga_host.h"
@@ -0,0 +1,520 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - a stand-in for the DaynaPORT SCSI target
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <time.h>
+#include "scsi_target.h"
+
+// Opcodes, as per scsiwifi.c
+#define SCSI_INQUIRY                        0x12
+#define SCSI_NETWORK_WIFI_READFRAME         0x08
+#define SCSI_NETWORK_WIFI_GETMACADDRESS     0x09
+#define SCSI_NETWORK_WIFI_WRITEFRAME        0x0A
+#define SCSI_NETWORK_WIFI_ADDMULTICAST      0x0D
+#define SCSI_NETWORK_WIFI_ENABLE            0x0E
+#define SCSI_NETWORK_WIFI_CMD               0x1c
+#define SCSI_NETWORK_WIFI_OPT_SCAN          0x01
+#define SCSI_NETWORK_WIFI_OPT_COMPLETE      0x02
+#define SCSI_NETWORK_WIFI_OPT_SCAN_RESULTS  0x03
+#define SCSI_NETWORK_WIFI_OPT_INFO          0x04
+#define SCSI_NETWORK_WIFI_OPT_JOIN          0x05
+#define SCSI_NETWORK_WIFI_OPT_ALTREAD       0x08
+#define SCSI_NETWORK_WIFI_OPT_GETMACADDRESS 0x09
+
+// ALTREAD variants in cdb[2]
+#define ALTREAD_PAD24           0xA8    // scsi.device
+#define ALTREAD_SINGLE          0xA9    // gvpscsi.device
+#define ALTREAD_PAD_BYTES       24
+
+#define STATUS_GOOD             0
+#define STATUS_CHECK_CONDITION  2
+
+#define CRC_SIZE    4
+#define HEADER_SIZE 6
+#define MORE_FRAMES 0x10
+
+// Batched reads: vendor bit in the control byte, and the header flag for "another frame follows"
+#define READ_BATCHED    0x40
+// WRITE FRAME control byte: frames carry a 4 byte header, and (vendor bit) several may follow each other
+#define WRITE_HEADER        0x80
+#define WRITE_BATCHED       0x40
+#define WRITE_HEADER_SIZE   4
+#define RECORD_FOLLOWS  0x40
+
+/****************************************************************************/
+/* Controller timing profiles                                               */
+/****************************************************************************/
+
+// These are approximations, good enough to put the command overhead against
+// the data phase in the right proportion for each class of controller.  scsi.device
+// can't take the plain READ's short transfers, and gvpscsi.device any but a full one
+const struct DaynaTarget_Timing DaynaTarget_TimingNone  = {"none",  "scsi.device",    0,    0,       0,      FALSE, 0};
+const struct DaynaTarget_Timing DaynaTarget_TimingA590  = {"a590",  "scsi.device",    1500, 650000,  250000, TRUE,  DAYNATARGET_READ_PLAIN};
+const struct DaynaTarget_Timing DaynaTarget_TimingA2091 = {"a2091", "scsi.device",    900,  1800000, 250000, FALSE, DAYNATARGET_READ_PLAIN};
+const struct DaynaTarget_Timing DaynaTarget_TimingGVP   = {"gvp",   "gvpscsi.device", 600,  3000000, 250000, FALSE, DAYNATARGET_READ_PLAIN | DAYNATARGET_READ_PAD24};
+
+const struct DaynaTarget_Timing* DaynaTarget_FindTiming(const char* name) {
+    static const struct DaynaTarget_Timing* profiles[] = {&DaynaTarget_TimingNone, &DaynaTarget_TimingA590, &DaynaTarget_TimingA2091, &DaynaTarget_TimingGVP};
+    for (unsigned i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++)
+        if (Stricmp(profiles[i]->name, name) == 0) return profiles[i];
+    return NULL;
+}
+
+static void sleepMicros(uint64_t micros) {
+    if (!micros) return;
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_nsec += (long)((micros % 1000000ULL) * 1000);
+    until.tv_sec += (time_t)(micros / 1000000ULL) + until.tv_nsec / 1000000000L;
+    until.tv_nsec %= 1000000000L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL));
+}
+
+// Holds the bus (and the calling task) for as long as the command would take
+static void busDelay(struct DaynaTarget* target, ULONG dataBytes) {
+    const struct DaynaTarget_Timing* timing = target->timing;
+    uint64_t data = timing->bytesPerSecond ? ((uint64_t)dataBytes * 1000000ULL) / timing->bytesPerSecond : 0;
+    uint64_t micros = timing->commandMicros + data;
+    if (!micros) return;
+
+    target->stats.busMicros += micros;
+    if (timing->cpuTransfer) target->stats.cpuMicros += data;
+    sleepMicros(micros);
+}
+
+/****************************************************************************/
+/* The network side                                                         */
+/****************************************************************************/
+
+void DaynaTarget_Init(struct DaynaTarget* target) {
+    static const UBYTE mac[6] = {0x00, 0x80, 0x19, 0x12, 0x34, 0x56};
+    memset(target, 0, sizeof(struct DaynaTarget));
+    target->scsiID = 4;
+    memcpy(target->mac, mac, 6);
+    target->rssi = -50;
+    target->channel = 6;
+    strcpy(target->ssid, "HostNetwork");
+    target->timing = &DaynaTarget_TimingNone;
+    target->ringSlots = DAYNATARGET_DEFAULT_SLOTS;
+    target->random = 0x12345678;
+    target->batchedReads = TRUE;
+    pthread_mutex_init(&target->lock, NULL);
+}
+
+void DaynaTarget_SetTraffic(struct DaynaTarget* target, const struct DaynaTarget_Traffic* traffic) {
+    pthread_mutex_lock(&target->lock);
+    target->traffic = *traffic;
+    if (target->traffic.bulkSize < 60) target->traffic.bulkSize = 60;
+    if (target->traffic.bulkSize > DAYNATARGET_FRAME_MAX) target->traffic.bulkSize = DAYNATARGET_FRAME_MAX;
+    target->trafficStart = HostShim_Micros();
+    target->bulkSent = target->arpSent = target->broadcastSent = target->strangerSent = 0;
+    pthread_mutex_unlock(&target->lock);
+}
+
+static ULONG nextRandom(struct DaynaTarget* target) {
+    target->random = target->random * 1103515245 + 12345;
+    return target->random >> 8;
+}
+
+// The firmware only passes on frames for us, broadcasts and multicasts we've registered
+static BOOL acceptAddress(struct DaynaTarget* target, const UBYTE* dest) {
+    if (target->passAll) return TRUE;
+    if (memcmp(dest, target->mac, 6) == 0) return TRUE;
+    if ((dest[0] & dest[1] & dest[2] & dest[3] & dest[4] & dest[5]) == 0xFF) return TRUE;
+    if (dest[0] & 1)
+        for (UWORD i = 0; i < target->multicastCount; i++)
+            if (memcmp(dest, target->multicast[i], 6) == 0) return TRUE;
+    return FALSE;
+}
+
+// The frame in target->incoming has arrived over the air.  If the filter lets
+// it through it goes into the next free slot, if there is one
+static void arrive(struct DaynaTarget* target, UWORD size) {
+    if (!acceptAddress(target, target->incoming)) {
+        target->stats.framesFiltered++;
+        return;
+    }
+    if (target->ringCount >= target->ringSlots) {
+        target->stats.framesOverrun++;
+        return;
+    }
+    UWORD slot = (target->ringHead + target->ringCount) % target->ringSlots;
+    memcpy(target->ring[slot], target->incoming, size);
+    target->ringSize[slot] = size;
+    target->ringCount++;
+    target->stats.framesArrived++;
+}
+
+static void buildHeader(UBYTE* frame, const UBYTE* dest, const UBYTE* src, UWORD type) {
+    memcpy(frame, dest, 6);
+    memcpy(frame + 6, src, 6);
+    frame[12] = type >> 8;
+    frame[13] = type & 0xFF;
+}
+
+static void arriveBulk(struct DaynaTarget* target) {
+    static const UBYTE server[6] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+    UBYTE* frame = target->incoming;
+    UWORD size = target->traffic.bulkSize;
+    buildHeader(frame, target->mac, server, 0x0800);
+    for (UWORD i = 14; i < size; i++) frame[i] = (UBYTE)(target->bulkSent + i);
+    target->bulkSent++;
+    arrive(target, size);
+}
+
+static void arriveARP(struct DaynaTarget* target) {
+    static const UBYTE broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    UBYTE host[6] = {0x00, 0x11, 0x22, 0x00, 0x00, 0x00};
+    UBYTE* frame = target->incoming;
+    host[5] = (UBYTE)nextRandom(target);
+    buildHeader(frame, broadcast, host, 0x0806);
+    memset(frame + 14, 0, 46);
+    frame[15] = 1;  frame[16] = 8;  frame[18] = 6;  frame[19] = 4;  frame[21] = 1;     // who-has
+    memcpy(frame + 22, host, 6);
+    target->arpSent++;
+    arrive(target, 60);
+}
+
+// Broadcasts and multicasts of all sorts, like a busy LAN full of discovery protocols
+static void arriveBroadcast(struct DaynaTarget* target) {
+    static const UBYTE destinations[4][6] = {
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB},   // mDNS
+        {0x33, 0x33, 0x00, 0x00, 0x00, 0x01},   // IPv6 all nodes
+        {0x01, 0x80, 0xC2, 0x00, 0x00, 0x00}    // spanning tree
+    };
+    static const UWORD types[4] = {0x0800, 0x0800, 0x86DD, 0x0026};
+    static const UBYTE host[6] = {0x00, 0x11, 0x22, 0x00, 0x00, 0x99};
+    UBYTE* frame = target->incoming;
+    ULONG which = nextRandom(target) & 3;
+    UWORD size = 60 + (UWORD)(nextRandom(target) % (DAYNATARGET_FRAME_MAX - 60));
+    buildHeader(frame, destinations[which], host, types[which]);
+    memset(frame + 14, 0xAA, size - 14);
+    target->broadcastSent++;
+    arrive(target, size);
+}
+
+// Other stations talking to each other, which the address filter normally hides
+static void arriveStranger(struct DaynaTarget* target) {
+    UBYTE from[6] = {0x00, 0x11, 0x22, 0x00, 0x01, 0x00}, to[6] = {0x00, 0x11, 0x22, 0x00, 0x02, 0x00};
+    UBYTE* frame = target->incoming;
+    UWORD size = 60 + (UWORD)(nextRandom(target) % (DAYNATARGET_FRAME_MAX - 60));
+    from[5] = (UBYTE)nextRandom(target);
+    to[5] = (UBYTE)nextRandom(target);
+    buildHeader(frame, to, from, 0x0800);
+    memset(frame + 14, 0x55, size - 14);
+    target->strangerSent++;
+    arrive(target, size);
+}
+
+// Have any more of this class arrived by now?
+static BOOL due(uint64_t elapsed, ULONG rate, ULONG sent) {
+    return (rate) && ((elapsed * rate) / 1000000ULL > sent);
+}
+
+// Brings the circular buffer up to date with everything that arrived since the last command
+static void advance(struct DaynaTarget* target) {
+    // Nothing is heard while the WiFi's not connected
+    if ((!target->enabled) || (!target->rssi)) return;
+    struct DaynaTarget_Traffic* traffic = &target->traffic;
+    uint64_t elapsed = HostShim_Micros() - target->trafficStart;
+
+    // Interleave the classes, as they'd have arrived mixed together
+    for (;;) {
+        BOOL any = FALSE;
+        if (due(elapsed, traffic->arpRate, target->arpSent)) {
+            arriveARP(target);
+            any = TRUE;
+        }
+        if (due(elapsed, traffic->broadcastRate, target->broadcastSent)) {
+            arriveBroadcast(target);
+            any = TRUE;
+        }
+        if (due(elapsed, traffic->strangerRate, target->strangerSent)) {
+            arriveStranger(target);
+            any = TRUE;
+        }
+        if ((traffic->bulkEnabled) && (due(elapsed, traffic->bulkRate, target->bulkSent))) {
+            arriveBulk(target);
+            any = TRUE;
+        }
+        if (!any) break;
+    }
+
+    // Unlimited bulk keeps the buffer topped up
+    if ((traffic->bulkEnabled) && (!traffic->bulkRate))
+        while (target->ringCount < target->ringSlots) arriveBulk(target);
+
+    // Anything from the host
+    if (target->source) {
+        while (target->ringCount < target->ringSlots) {
+            UWORD size = target->source(target->callbackContext, target->incoming, DAYNATARGET_FRAME_MAX);
+            if (!size) break;
+            arrive(target, size);
+        }
+    }
+}
+
+/****************************************************************************/
+/* SCSI commands                                                            */
+/****************************************************************************/
+
+static ULONG copyOut(struct SCSICmd* cmd, const void* data, ULONG size) {
+    if (size > cmd->scsi_Length) size = cmd->scsi_Length;
+    if (size) memcpy(cmd->scsi_Data, data, size);
+    cmd->scsi_Actual = size;
+    return size;
+}
+
+// Moves the frame at the head of the circular buffer to out as a 6 byte header,
+// the frame and its CRC.  Returns the size written
+static ULONG popFrame(struct DaynaTarget* target, UBYTE* out, ULONG space) {
+    UWORD slot = target->ringHead;
+    UWORD size = target->ringSize[slot];
+    if (size + CRC_SIZE + HEADER_SIZE > space) size = space - HEADER_SIZE - CRC_SIZE;
+    memset(out, 0, HEADER_SIZE);
+    out[0] = (size + CRC_SIZE) >> 8;
+    out[1] = (size + CRC_SIZE) & 0xFF;
+    memcpy(out + HEADER_SIZE, target->ring[slot], size);
+    memset(out + HEADER_SIZE + size, 0, CRC_SIZE);
+    target->stats.framesReceived++;
+    target->stats.bytesReceived += size;
+
+    target->ringHead = (target->ringHead + 1) % target->ringSlots;
+    target->ringCount--;
+    if (target->ringCount) out[5] = MORE_FRAMES;
+    return HEADER_SIZE + size + CRC_SIZE;
+}
+
+// READ FRAME - 6 byte header followed by the frame and its CRC.  With the
+// batched bit in the control byte, as many frames as fit, each word aligned and
+// flagged if another follows.  Returns the number of bytes that crossed the bus
+static ULONG readFrame(struct DaynaTarget* target, struct SCSICmd* cmd, ULONG allocation, UBYTE variant, UBYTE control, BYTE* hostError) {
+    UBYTE* out = (UBYTE*)cmd->scsi_Data;
+    if (allocation > cmd->scsi_Length) allocation = cmd->scsi_Length;
+    if (allocation < HEADER_SIZE + CRC_SIZE) {
+        cmd->scsi_Status = STATUS_CHECK_CONDITION;
+        return 0;
+    }
+
+    advance(target);
+    memset(out, 0, HEADER_SIZE);
+    cmd->scsi_Actual = HEADER_SIZE;
+
+    if (!target->ringCount) {
+        target->stats.emptyReads++;
+    } else {
+        BOOL batched = (control & READ_BATCHED) && (target->batchedReads);
+        UBYTE* last = NULL;
+        ULONG pos = 0;
+        do {
+            ULONG needed = HEADER_SIZE + target->ringSize[target->ringHead] + CRC_SIZE;
+            if ((last) && (pos + needed > allocation)) break;
+            if (last) last[5] |= RECORD_FOLLOWS;
+            last = out + pos;
+            cmd->scsi_Actual = pos + popFrame(target, last, allocation - pos);
+            pos = (cmd->scsi_Actual + 1) & ~1;
+        } while ((batched) && (target->ringCount) && (pos < allocation));
+        if (batched) target->stats.batchedReads++;
+    }
+
+    // What actually goes over the bus depends on the variant.  The scsi.device
+    // variant pads the transfer, the gvpscsi one sends the whole allocation in
+    // a single transfer whatever the frame size
+    ULONG busBytes = cmd->scsi_Actual;
+    UBYTE bit = DAYNATARGET_READ_PLAIN;
+    switch (variant) {
+        case ALTREAD_PAD24:  busBytes += ALTREAD_PAD_BYTES; bit = DAYNATARGET_READ_PAD24; break;
+        case ALTREAD_SINGLE: busBytes = allocation;         bit = DAYNATARGET_READ_SINGLE; break;
+    }
+    // A variant the controller's driver can't cope with loses the data phase, and whatever was in it
+    if (target->timing->badReads & bit) {
+        cmd->scsi_Actual = 0;
+        *hostError = HFERR_Phase;
+    }
+    return busBytes;
+}
+
+// Hands one frame the driver wrote to the sink
+static void sendFrame(struct DaynaTarget* target, UBYTE* frame, ULONG size) {
+    target->stats.framesSent++;
+    target->stats.bytesSent += size;
+    if ((target->sink) && (target->rssi)) target->sink(target->callbackContext, frame, (UWORD)size);
+}
+
+// WRITE FRAME.  Either a single raw frame, or with the header bit set frames each
+// preceded by a 4 byte header (size, flags), several of them if the batched bit
+// was also set.  Older firmware only ever looks at the first header
+static void writeFrame(struct DaynaTarget* target, struct SCSICmd* cmd, ULONG size, UBYTE control) {
+    UBYTE* data = (UBYTE*)cmd->scsi_Data;
+    if (size > cmd->scsi_Length) size = cmd->scsi_Length;
+    cmd->scsi_Actual = size;
+
+    if (!(control & WRITE_HEADER)) {
+        sendFrame(target, data, size);
+        return;
+    }
+
+    BOOL batched = (control & WRITE_BATCHED) && (target->batchedReads);
+    ULONG pos = 0;
+    while (pos + WRITE_HEADER_SIZE <= size) {
+        UBYTE* header = data + pos;
+        ULONG frameSize = ((ULONG)header[0] << 8) | header[1];
+        if ((!frameSize) || (pos + WRITE_HEADER_SIZE + frameSize > size)) {
+            target->stats.badCommands++;
+            cmd->scsi_Status = STATUS_CHECK_CONDITION;
+            return;
+        }
+        sendFrame(target, header + WRITE_HEADER_SIZE, frameSize);
+        if ((!batched) || (!(header[2] & RECORD_FOLLOWS))) break;
+        pos = (pos + WRITE_HEADER_SIZE + frameSize + 1) & ~1;
+    }
+    if (batched) target->stats.batchedWrites++;
+}
+
+static BYTE targetCommand(void* context, ULONG unit, struct SCSICmd* cmd) {
+    struct DaynaTarget* target = (struct DaynaTarget*)context;
+    UBYTE* cdb = cmd->scsi_Command;
+    ULONG busBytes = 0;
+    BYTE hostError = 0;
+    (void)unit;
+
+    pthread_mutex_lock(&target->lock);
+    cmd->scsi_Status = STATUS_GOOD;
+    cmd->scsi_Actual = 0;
+    cmd->scsi_SenseActual = 0;
+
+    switch (cdb[0]) {
+        case SCSI_INQUIRY: {
+            UBYTE inquiry[36];
+            memset(inquiry, ' ', sizeof(inquiry));
+            inquiry[0] = 0x03;      // processor device
+            inquiry[1] = 0;
+            inquiry[2] = 0x02;
+            inquiry[3] = 0x02;
+            inquiry[4] = sizeof(inquiry) - 5;
+            inquiry[5] = inquiry[6] = inquiry[7] = 0;
+            memcpy(&inquiry[8], "Dayna", 5);
+            memcpy(&inquiry[16], "SCSI/Link", 9);
+            memcpy(&inquiry[32], "2.0f", 4);
+            busBytes = copyOut(cmd, inquiry, (cdb[4] < sizeof(inquiry)) ? cdb[4] : sizeof(inquiry));
+            break;
+        }
+
+        case SCSI_NETWORK_WIFI_READFRAME:
+            busBytes = readFrame(target, cmd, ((ULONG)cdb[3] << 8) | cdb[4], 0, cdb[5], &hostError);
+            break;
+
+        case SCSI_NETWORK_WIFI_GETMACADDRESS:
+            busBytes = copyOut(cmd, target->mac, 6);
+            break;
+
+        case SCSI_NETWORK_WIFI_WRITEFRAME:
+            writeFrame(target, cmd, ((ULONG)cdb[3] << 8) | cdb[4], cdb[5]);
+            busBytes = cmd->scsi_Actual;
+            break;
+
+        case SCSI_NETWORK_WIFI_ADDMULTICAST: {
+            // One or more 6 byte addresses, size in cdb[4] (the driver also sets cdb[3])
+            ULONG size = cdb[4] ? cdb[4] : cdb[3];
+            if (size > cmd->scsi_Length) size = cmd->scsi_Length;
+            UBYTE* address = (UBYTE*)cmd->scsi_Data;
+            for (ULONG pos = 0; pos + 6 <= size; pos += 6) {
+                UWORD i;
+                for (i = 0; i < target->multicastCount; i++)
+                    if (memcmp(target->multicast[i], address + pos, 6) == 0) break;
+                if ((i == target->multicastCount) && (target->multicastCount < DAYNATARGET_MAX_MULTICAST))
+                    memcpy(target->multicast[target->multicastCount++], address + pos, 6);
+            }
+            cmd->scsi_Actual = busBytes = size;
+            break;
+        }
+
+        case SCSI_NETWORK_WIFI_ENABLE:
+            // Enabling (or disabling) resets the circular buffer
+            target->enabled = (cdb[5] & 0x80) ? TRUE : FALSE;
+            target->ringHead = target->ringCount = 0;
+            // ...and here the multicast list too, so a driver has to add them again after it
+            target->multicastCount = 0;
+            break;
+
+        case SCSI_NETWORK_WIFI_CMD:
+            switch (cdb[1]) {
+                case SCSI_NETWORK_WIFI_OPT_SCAN: {
+                    UBYTE busy = 0xFF;
+                    busBytes = copyOut(cmd, &busy, 1);
+                    break;
+                }
+                case SCSI_NETWORK_WIFI_OPT_COMPLETE: {
+                    UBYTE done = 1;
+                    busBytes = copyOut(cmd, &done, 1);
+                    break;
+                }
+                case SCSI_NETWORK_WIFI_OPT_SCAN_RESULTS: {
+                    UBYTE none[2] = {0, 0};
+                    busBytes = copyOut(cmd, none, 2);
+                    break;
+                }
+                case SCSI_NETWORK_WIFI_OPT_INFO: {
+                    // 2 byte size then a SCSIWifi_NetworkEntry
+                    UBYTE info[2 + 74];
+                    memset(info, 0, sizeof(info));
+                    info[1] = 74;
+                    if (target->rssi) {
+                        memcpy(&info[2], target->ssid, strnlen(target->ssid, 63));
+                        info[2 + 70] = (UBYTE)target->rssi;
+                        info[2 + 71] = target->channel;
+                    }
+                    busBytes = copyOut(cmd, info, sizeof(info));
+                    break;
+                }
+                case SCSI_NETWORK_WIFI_OPT_JOIN:
+                    cmd->scsi_Actual = busBytes = cmd->scsi_Length;
+                    break;
+                case SCSI_NETWORK_WIFI_OPT_ALTREAD:
+                    busBytes = readFrame(target, cmd, ((ULONG)cdb[3] << 8) | cdb[4], cdb[2], cdb[5], &hostError);
+                    break;
+                case SCSI_NETWORK_WIFI_OPT_GETMACADDRESS:
+                    busBytes = copyOut(cmd, target->mac, 6);
+                    break;
+                default:
+                    cmd->scsi_Status = STATUS_CHECK_CONDITION;
+                    break;
+            }
+            break;
+
+        default:
+            cmd->scsi_Status = STATUS_CHECK_CONDITION;
+            break;
+    }
+
+    if (cmd->scsi_Status) target->stats.badCommands++;
+    busDelay(target, busBytes);
+    pthread_mutex_unlock(&target->lock);
+    if (hostError) return hostError;
+    return cmd->scsi_Status ? HFERR_BadStatus : 0;
+}
+
+static BYTE targetOpen(void* context, const char* deviceName, ULONG unit) {
+    struct DaynaTarget* target = (struct DaynaTarget*)context;
+    (void)deviceName;
+    if (unit == target->scsiID) return 0;
+
+    // Anything else behaves like an empty ID, which costs a selection timeout
+    sleepMicros(target->timing->selectionTimeoutMicros);
+    return HFERR_SelTimeout;
+}
+
+void DaynaTarget_Install(struct DaynaTarget* target) {
+    struct HostSCSIBackend backend;
+    memset(&backend, 0, sizeof(backend));
+    backend.open = targetOpen;
+    backend.command = targetCommand;
+    backend.context = target;
+    // With no timing cost there's nothing to overlap, so keep it simple
+    backend.dma = (!target->timing->cpuTransfer) && ((target->timing->commandMicros) || (target->timing->bytesPerSecond));
+    HostSCSI_SetBackend(&backend);
+}
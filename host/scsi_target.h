@@ -0,0 +1,133 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - a stand-in for the DaynaPORT SCSI target
+ *
+ * Answers the commands scsiwifi.c issues the same way the BlueSCSI/ZuluSCSI
+ * firmware does.  Frames arrive from the "network" into a circular buffer of
+ * packet slots, either from the built in traffic generators or from a host
+ * callback, and are handed out one per READ with the "more" flag set while the
+ * buffer still holds frames.  Each command takes as long as the selected
+ * controller timing profile says it would on real hardware.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+#ifndef SCSI_TARGET_H
+#define SCSI_TARGET_H 1
+
+#include "amiga_host.h"
+
+#define DAYNATARGET_FRAME_MAX       1514
+#define DAYNATARGET_MAX_SLOTS       64
+#define DAYNATARGET_DEFAULT_SLOTS   20
+#define DAYNATARGET_MAX_MULTICAST   16
+
+// Called when the driver asks for a frame, for traffic the generators don't cover.
+// Write a complete ethernet frame (no CRC) to frame and return its size, or 0
+// if nothing has "arrived".  maxSize is never less than 1514.
+typedef UWORD (*DaynaTarget_FrameSource)(void* context, UBYTE* frame, UWORD maxSize);
+
+// Called for every frame the driver sends
+typedef void (*DaynaTarget_FrameSink)(void* context, const UBYTE* frame, UWORD size);
+
+// How long a command takes on a given controller.  Each command costs
+// commandMicros (selection, CDB, status, plus the controller driver's own
+// overhead) and then its data phase at bytesPerSecond.
+struct DaynaTarget_Timing {
+    const char* name;
+    const char* driverName;         // the SCSI driver that goes with it
+    ULONG commandMicros;
+    ULONG bytesPerSecond;           // 0 = data phase is free
+    ULONG selectionTimeoutMicros;   // time wasted opening an empty ID
+    BOOL  cpuTransfer;              // PIO - the CPU moves every byte
+    UBYTE badReads;                 // DAYNATARGET_READ_ bits for the READ variants its driver gets wrong
+};
+
+// READ variants, as in MODE 0, 1 and 2
+#define DAYNATARGET_READ_PLAIN      0x01
+#define DAYNATARGET_READ_PAD24      0x02
+#define DAYNATARGET_READ_SINGLE     0x04
+
+extern const struct DaynaTarget_Timing DaynaTarget_TimingNone;
+extern const struct DaynaTarget_Timing DaynaTarget_TimingA590;   // A590, scsi.device, PIO
+extern const struct DaynaTarget_Timing DaynaTarget_TimingA2091;  // A2091, scsi.device, DMA
+extern const struct DaynaTarget_Timing DaynaTarget_TimingGVP;    // GVP Series II, gvpscsi.device, DMA
+
+// Looks up a profile by name (none, a590, a2091, gvp), NULL if unknown
+const struct DaynaTarget_Timing* DaynaTarget_FindTiming(const char* name);
+
+// Built in traffic, in frames per second of each class arriving from the network.
+// A bulk rate of 0 with bulkEnabled set keeps the circular buffer full.
+struct DaynaTarget_Traffic {
+    BOOL  bulkEnabled;
+    ULONG bulkRate;                 // TCP data segments addressed to us
+    UWORD bulkSize;                 // ethernet frame size of those segments
+    ULONG arpRate;                  // broadcast ARP who-has chatter
+    ULONG broadcastRate;            // storm of broadcast/multicast frames of mixed types and sizes
+    ULONG strangerRate;             // unicasts between other stations, only heard without the address filter
+};
+
+struct DaynaTarget_Stats {
+    ULONG framesReceived;       // frames handed to the driver
+    ULONG bytesReceived;
+    ULONG emptyReads;           // reads that found nothing waiting
+    ULONG framesSent;           // frames the driver wrote
+    ULONG bytesSent;
+    ULONG badCommands;          // anything we answered with CHECK CONDITION
+    ULONG framesArrived;        // frames accepted from the network
+    ULONG framesFiltered;       // frames the address filter threw away
+    ULONG framesOverrun;        // frames lost because the circular buffer was full
+    ULONG batchedReads;         // reads that asked for several frames and got at least one
+    ULONG batchedWrites;        // writes that carried several frames
+    uint64_t busMicros;         // time the bus was busy
+    uint64_t cpuMicros;         // ...of which the CPU was moving data (PIO)
+};
+
+struct DaynaTarget {
+    UBYTE scsiID;               // The ID the target answers on
+    UBYTE mac[6];
+    BYTE  rssi;                 // 0 = not connected
+    UBYTE channel;
+    char  ssid[64];
+    BOOL  enabled;
+    BOOL  batchedReads;         // honours the batched bit on READs and WRITEs, FALSE behaves like older firmware
+    BOOL  passAll;              // no address filter, every frame heard goes to the driver
+
+    const struct DaynaTarget_Timing* timing;
+    struct DaynaTarget_Traffic traffic;
+    UWORD ringSlots;            // size of the circular buffer, in frames
+
+    DaynaTarget_FrameSource source;
+    DaynaTarget_FrameSink   sink;
+    void*                   callbackContext;
+
+    struct DaynaTarget_Stats stats;
+    pthread_mutex_t lock;
+
+    // Multicast addresses the driver has registered
+    UBYTE multicast[DAYNATARGET_MAX_MULTICAST][6];
+    UWORD multicastCount;
+
+    // The circular buffer
+    UWORD ringHead, ringCount;
+    UWORD ringSize[DAYNATARGET_MAX_SLOTS];
+    UBYTE ring[DAYNATARGET_MAX_SLOTS][DAYNATARGET_FRAME_MAX];
+
+    // Traffic generator state
+    UBYTE incoming[DAYNATARGET_FRAME_MAX];
+    uint64_t trafficStart;
+    ULONG bulkSent, arpSent, broadcastSent, strangerSent;
+    ULONG random;
+};
+
+// Sets up a connected target on SCSI ID 4 with a fixed MAC address, no traffic
+// and no timing cost
+void DaynaTarget_Init(struct DaynaTarget* target);
+
+// Makes this target the SCSI controller that OpenDevice() talks to.  Set the timing
+// first: DMA controllers run commands on their own task, PIO ones in the caller
+void DaynaTarget_Install(struct DaynaTarget* target);
+
+// Changes the traffic mix, restarting the generators
+void DaynaTarget_SetTraffic(struct DaynaTarget* target, const struct DaynaTarget_Traffic* traffic);
+
+#endif
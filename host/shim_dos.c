@@ -0,0 +1,173 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - dos.library
+ *
+ * ENV: and ENVARC: are mapped onto host directories, everything else is
+ * passed straight through to the host filesystem.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <unistd.h>
+#include "shim_internal.h"
+
+static char _envDir[512] = "";
+static char _envarcDir[512] = "";
+
+void HostShim_SetEnvDirs(const char* env, const char* envarc) {
+    if (env) snprintf(_envDir, sizeof(_envDir), "%s", env);
+    if (envarc) snprintf(_envarcDir, sizeof(_envarcDir), "%s", envarc);
+}
+
+static const char* envDir(BOOL archive) {
+    const char* dir = archive ? _envarcDir : _envDir;
+    if (!dir[0]) dir = getenv(archive ? "SCSIDAYNA_ENVARC" : "SCSIDAYNA_ENV");
+    return ((dir) && (dir[0])) ? dir : ".";
+}
+
+// Maps an Amiga path onto the host
+static void hostPath(CONST_STRPTR name, char* out, size_t outSize) {
+    if (Strnicmp(name, "ENVARC:", 7) == 0) snprintf(out, outSize, "%s/%s", envDir(TRUE), name + 7); else
+    if (Strnicmp(name, "ENV:", 4) == 0) snprintf(out, outSize, "%s/%s", envDir(FALSE), name + 4); else
+    snprintf(out, outSize, "%s", name);
+}
+
+BPTR Open(CONST_STRPTR name, LONG accessMode) {
+    char path[1024];
+    FILE* f;
+    hostPath(name, path, sizeof(path));
+    switch (accessMode) {
+        case MODE_NEWFILE:   f = fopen(path, "wb"); break;
+        case MODE_READWRITE: f = fopen(path, "r+b"); if (!f) f = fopen(path, "w+b"); break;
+        default:             f = fopen(path, "rb"); break;
+    }
+    return (BPTR)f;
+}
+
+LONG Close(BPTR file) {
+    if (!file) return 1;
+    return fclose((FILE*)file) == 0;
+}
+
+LONG Read(BPTR file, APTR buffer, LONG length) {
+    size_t r = fread(buffer, 1, length, (FILE*)file);
+    if ((r == 0) && (ferror((FILE*)file))) return -1;
+    return (LONG)r;
+}
+
+LONG Write(BPTR file, CONST APTR buffer, LONG length) {
+    size_t w = fwrite(buffer, 1, length, (FILE*)file);
+    return (w == (size_t)length) ? (LONG)w : -1;
+}
+
+STRPTR FGets(BPTR fh, STRPTR buf, ULONG len) {
+    return fgets(buf, len, (FILE*)fh);
+}
+
+// As per the autodoc, 0 is success
+LONG FPuts(BPTR fh, CONST_STRPTR str) {
+    return (fputs(str, (FILE*)fh) >= 0) ? 0 : -1;
+}
+
+LONG DeleteFile(CONST_STRPTR name) {
+    char path[1024];
+    hostPath(name, path, sizeof(path));
+    return unlink(path) == 0;
+}
+
+void Delay(LONG timeout) {
+    if (timeout > 0) usleep((useconds_t)timeout * 20000);
+}
+
+LONG GetVar(CONST_STRPTR name, STRPTR buffer, LONG size, LONG flags) {
+    char path[1024];
+    (void)flags;
+    snprintf(path, sizeof(path), "ENV:%s", name);
+    BPTR fh = Open(path, MODE_OLDFILE);
+    if (!fh) return -1;
+    LONG len = Read(fh, buffer, size - 1);
+    Close(fh);
+    if (len < 0) return -1;
+    buffer[len] = '\0';
+    return len;
+}
+
+/****************************************************************************/
+/* Processes                                                                */
+/****************************************************************************/
+
+struct ProcStart {
+    struct Process* proc;
+    void (*entry)(void);
+};
+
+static void* processThread(void* arg) {
+    struct ProcStart start = *(struct ProcStart*)arg;
+    free(arg);
+    // The Process *is* the task for this thread
+    _HostTask_Adopt(&start.proc->pr_Task);
+    start.entry();
+    // Exec would reclaim the process when it falls off the end, but the
+    // driver may still Signal() it while it does so.  Leak it rather than race.
+    return NULL;
+}
+
+struct Process* CreateNewProcTagList(const struct TagItem* tags) {
+    void (*entry)(void) = (void (*)(void))GetTagData(NP_Entry, 0, tags);
+    if (!entry) return NULL;
+
+    struct Process* proc = calloc(1, sizeof(struct Process));
+    struct ProcStart* start = malloc(sizeof(struct ProcStart));
+    proc->pr_Task.tc_Node.ln_Name = (char*)GetTagData(NP_Name, (IPTR)"host process", tags);
+    proc->pr_Task.tc_Node.ln_Pri = (BYTE)(LONG)GetTagData(NP_Priority, 0, tags);
+    proc->pr_MsgPort.mp_Node.ln_Type = NT_MSGPORT;
+    proc->pr_MsgPort.mp_Flags = PA_SIGNAL;
+    proc->pr_MsgPort.mp_SigBit = SIGB_DOS;
+    proc->pr_MsgPort.mp_SigTask = &proc->pr_Task;
+    NewList(&proc->pr_MsgPort.mp_MsgList);
+    start->proc = proc;
+    start->entry = entry;
+
+    pthread_t thread;
+    _HostTask_Init(&proc->pr_Task, NT_PROCESS);
+    if (pthread_create(&thread, NULL, processThread, start)) {
+        free(start);
+        free(proc);
+        return NULL;
+    }
+    pthread_detach(thread);
+    return proc;
+}
+
+// The varargs form.  Tags are read back as IPTRs, so values passed as plain
+// ints are truncated to 32 bits below, as they would be on the Amiga
+struct Process* _host_CreateNewProcTags(int dummy, ...) {
+    struct TagItem tags[32];
+    va_list args;
+    int count = 0;
+    va_start(args, dummy);
+    for (;;) {
+        Tag tag = (Tag)va_arg(args, IPTR);
+        if ((tag == TAG_DONE) || (count == 31)) break;
+        tags[count].ti_Tag = tag;
+        tags[count].ti_Data = va_arg(args, IPTR);
+        if (tag == NP_Priority) tags[count].ti_Data = (IPTR)(LONG)tags[count].ti_Data;
+        count++;
+    }
+    va_end(args);
+    tags[count].ti_Tag = TAG_DONE;
+    tags[count].ti_Data = 0;
+    return CreateNewProcTagList(tags);
+}
+
+/****************************************************************************/
+/* debug.lib                                                                */
+/****************************************************************************/
+
+// Only used when built with debug=1, goes to stderr rather than the serial port
+void KPrintF(char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
@@ -0,0 +1,628 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - exec.library, utility.library and amiga.lib
+ *
+ * Tasks are pthreads.  Each task has a condition variable that Wait() sleeps
+ * on, and all signal/message port state is protected by a single lock, which
+ * plays the part of Disable().
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <time.h>
+#include <errno.h>
+#include "shim_internal.h"
+
+pthread_mutex_t _HostExec_Lock = PTHREAD_MUTEX_INITIALIZER;
+struct HostShimStats HostShim_Stats;
+
+static __thread struct Task* _currentTask = NULL;
+static struct HostSCSIBackend _scsiBackend;
+static struct Device _scsiDevice;
+
+// The DMA controller's task and its queue of commands
+static pthread_mutex_t _scsiQueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _scsiQueueCond = PTHREAD_COND_INITIALIZER;
+static struct List _scsiQueue;
+static BOOL _scsiTaskRunning = FALSE;
+
+/****************************************************************************/
+/* Time                                                                     */
+/****************************************************************************/
+
+uint64_t HostShim_Micros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+/****************************************************************************/
+/* Lists                                                                    */
+/****************************************************************************/
+
+void NewList(struct List* list) {
+    list->lh_Head = (struct Node*)&list->lh_Tail;
+    list->lh_Tail = NULL;
+    list->lh_TailPred = (struct Node*)&list->lh_Head;
+}
+
+void AddHead(struct List* list, struct Node* node) {
+    node->ln_Succ = list->lh_Head;
+    node->ln_Pred = (struct Node*)&list->lh_Head;
+    list->lh_Head->ln_Pred = node;
+    list->lh_Head = node;
+}
+
+void AddTail(struct List* list, struct Node* node) {
+    node->ln_Succ = (struct Node*)&list->lh_Tail;
+    node->ln_Pred = list->lh_TailPred;
+    list->lh_TailPred->ln_Succ = node;
+    list->lh_TailPred = node;
+}
+
+void Remove(struct Node* node) {
+    node->ln_Pred->ln_Succ = node->ln_Succ;
+    node->ln_Succ->ln_Pred = node->ln_Pred;
+}
+
+struct Node* RemHead(struct List* list) {
+    struct Node* node = list->lh_Head;
+    if (!node->ln_Succ) return NULL;
+    Remove(node);
+    return node;
+}
+
+struct Node* RemTail(struct List* list) {
+    struct Node* node = list->lh_TailPred;
+    if (!node->ln_Pred) return NULL;
+    Remove(node);
+    return node;
+}
+
+void Insert(struct List* list, struct Node* node, struct Node* pred) {
+    if (!pred) {
+        AddHead(list, node);
+        return;
+    }
+    if (!pred->ln_Succ) {
+        AddTail(list, node);
+        return;
+    }
+    node->ln_Succ = pred->ln_Succ;
+    node->ln_Pred = pred;
+    pred->ln_Succ->ln_Pred = node;
+    pred->ln_Succ = node;
+}
+
+void Enqueue(struct List* list, struct Node* node) {
+    struct Node* next;
+    for (next = list->lh_Head; next->ln_Succ; next = next->ln_Succ)
+        if (next->ln_Pri < node->ln_Pri) break;
+    Insert(list, node, next->ln_Pred);
+}
+
+struct Node* FindName(struct List* list, CONST_STRPTR name) {
+    for (struct Node* node = list->lh_Head; node->ln_Succ; node = node->ln_Succ)
+        if ((node->ln_Name) && (strcmp(node->ln_Name, name) == 0)) return node;
+    return NULL;
+}
+
+/****************************************************************************/
+/* Memory                                                                   */
+/****************************************************************************/
+
+APTR AllocMem(ULONG byteSize, ULONG requirements) {
+    __atomic_add_fetch(&HostShim_Stats.allocs, 1, __ATOMIC_RELAXED);
+    if (requirements & MEMF_CLEAR) return calloc(1, byteSize);
+    return malloc(byteSize);
+}
+
+void FreeMem(APTR memoryBlock, ULONG byteSize) {
+    (void)byteSize;
+    if (!memoryBlock) return;
+    __atomic_add_fetch(&HostShim_Stats.frees, 1, __ATOMIC_RELAXED);
+    free(memoryBlock);
+}
+
+// AllocVec remembers the size in front of the block.  16 bytes keeps the
+// block as aligned as malloc would have it
+APTR AllocVec(ULONG byteSize, ULONG requirements) {
+    UBYTE* mem = AllocMem(byteSize + 16, requirements);
+    if (!mem) return NULL;
+    *((ULONG*)mem) = byteSize + 16;
+    return mem + 16;
+}
+
+void FreeVec(APTR memoryBlock) {
+    if (!memoryBlock) return;
+    UBYTE* mem = ((UBYTE*)memoryBlock) - 16;
+    FreeMem(mem, *((ULONG*)mem));
+}
+
+/****************************************************************************/
+/* Tasks and signals                                                        */
+/****************************************************************************/
+
+void _HostTask_Init(struct Task* task, UBYTE type) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&task->tc_HostCond, &attr);
+    pthread_condattr_destroy(&attr);
+    task->tc_Node.ln_Type = type;
+    task->tc_SigAlloc = 0xFFFF;      // the lower 16 belong to the system
+}
+
+void _HostTask_Adopt(struct Task* task) {
+    task->tc_HostThread = pthread_self();
+    _currentTask = task;
+}
+
+struct Task* _HostTask_Current(void) {
+    if (!_currentTask) {
+        struct Task* task = calloc(1, sizeof(struct Task));
+        _HostTask_Init(task, NT_TASK);
+        task->tc_Node.ln_Name = "host thread";
+        _HostTask_Adopt(task);
+    }
+    return _currentTask;
+}
+
+struct Task* FindTask(CONST_STRPTR name) {
+    if (name) return NULL;    // no task list to search on the host
+    return _HostTask_Current();
+}
+
+BYTE SetTaskPri(struct Task* task, LONG priority) {
+    BYTE old = task->tc_Node.ln_Pri;
+    task->tc_Node.ln_Pri = (BYTE)priority;
+    return old;
+}
+
+BYTE AllocSignal(LONG signalNum) {
+    struct Task* task = _HostTask_Current();
+    pthread_mutex_lock(&_HostExec_Lock);
+    if (signalNum < 0) {
+        for (signalNum = 31; signalNum >= 0; signalNum--)
+            if (!(task->tc_SigAlloc & (1UL << signalNum))) break;
+    } else if (task->tc_SigAlloc & (1UL << signalNum)) signalNum = -1;
+    if (signalNum >= 0) {
+        task->tc_SigAlloc |= (1UL << signalNum);
+        task->tc_SigRecvd &= ~(1UL << signalNum);
+    }
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return (BYTE)signalNum;
+}
+
+void FreeSignal(LONG signalNum) {
+    if (signalNum < 0) return;
+    struct Task* task = _HostTask_Current();
+    pthread_mutex_lock(&_HostExec_Lock);
+    task->tc_SigAlloc &= ~(1UL << signalNum);
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+void _HostSignal_Locked(struct Task* task, ULONG signalSet) {
+    task->tc_SigRecvd |= signalSet;
+    if (task->tc_SigRecvd & task->tc_SigWait) pthread_cond_signal(&task->tc_HostCond);
+}
+
+void Signal(struct Task* task, ULONG signalSet) {
+    if (!task) return;
+    pthread_mutex_lock(&_HostExec_Lock);
+    _HostSignal_Locked(task, signalSet);
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+ULONG SetSignal(ULONG newSignals, ULONG signalSet) {
+    struct Task* task = _HostTask_Current();
+    pthread_mutex_lock(&_HostExec_Lock);
+    _HostTimer_Run_Locked();
+    ULONG old = task->tc_SigRecvd;
+    task->tc_SigRecvd = (old & ~signalSet) | (newSignals & signalSet);
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return old;
+}
+
+ULONG Wait(ULONG signalSet) {
+    struct Task* task = _HostTask_Current();
+    BOOL blocked = FALSE;
+
+    pthread_mutex_lock(&_HostExec_Lock);
+    task->tc_SigWait = signalSet;
+    for (;;) {
+        // Nothing else drives timer.device, so whoever is waiting does
+        uint64_t deadline = _HostTimer_Run_Locked();
+        if (task->tc_SigRecvd & signalSet) break;
+        blocked = TRUE;
+        if (deadline) {
+            struct timespec ts;
+            ts.tv_sec = deadline / 1000000ULL;
+            ts.tv_nsec = (deadline % 1000000ULL) * 1000;
+            pthread_cond_timedwait(&task->tc_HostCond, &_HostExec_Lock, &ts);
+        } else pthread_cond_wait(&task->tc_HostCond, &_HostExec_Lock);
+    }
+    ULONG result = task->tc_SigRecvd & signalSet;
+    task->tc_SigRecvd &= ~signalSet;
+    task->tc_SigWait = 0;
+    if (blocked) HostShim_Stats.waits++;
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return result;
+}
+
+// There is no multitasking to forbid on the host, every task really runs in
+// parallel.  The driver only uses this around its own exit.
+void Forbid(void) {}
+void Permit(void) {}
+void Disable(void) {}
+void Enable(void) {}
+
+/****************************************************************************/
+/* Semaphores                                                               */
+/****************************************************************************/
+
+void InitSemaphore(struct SignalSemaphore* sigSem) {
+    pthread_mutexattr_t attr;
+    memset(sigSem, 0, sizeof(struct SignalSemaphore));
+    sigSem->ss_Link.ln_Type = NT_SEMAPHORE;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sigSem->ss_HostMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void ObtainSemaphore(struct SignalSemaphore* sigSem) {
+    pthread_mutex_lock(&sigSem->ss_HostMutex);
+    sigSem->ss_Owner = _HostTask_Current();
+    sigSem->ss_NestCount++;
+}
+
+ULONG AttemptSemaphore(struct SignalSemaphore* sigSem) {
+    if (pthread_mutex_trylock(&sigSem->ss_HostMutex)) return 0;
+    sigSem->ss_Owner = _HostTask_Current();
+    sigSem->ss_NestCount++;
+    return 1;
+}
+
+void ReleaseSemaphore(struct SignalSemaphore* sigSem) {
+    if (--sigSem->ss_NestCount == 0) sigSem->ss_Owner = NULL;
+    pthread_mutex_unlock(&sigSem->ss_HostMutex);
+}
+
+/****************************************************************************/
+/* Message ports                                                            */
+/****************************************************************************/
+
+struct MsgPort* CreateMsgPort(void) {
+    BYTE sigBit = AllocSignal(-1);
+    if (sigBit < 0) return NULL;
+    struct MsgPort* port = AllocMem(sizeof(struct MsgPort), MEMF_PUBLIC | MEMF_CLEAR);
+    if (!port) {
+        FreeSignal(sigBit);
+        return NULL;
+    }
+    port->mp_Node.ln_Type = NT_MSGPORT;
+    port->mp_Flags = PA_SIGNAL;
+    port->mp_SigBit = sigBit;
+    port->mp_SigTask = _HostTask_Current();
+    NewList(&port->mp_MsgList);
+    return port;
+}
+
+void DeleteMsgPort(struct MsgPort* port) {
+    if (!port) return;
+    FreeSignal(port->mp_SigBit);
+    FreeMem(port, sizeof(struct MsgPort));
+}
+
+// Public ports aren't searchable on the host, so these just keep the list valid
+void AddPort(struct MsgPort* port) {
+    NewList(&port->mp_MsgList);
+}
+
+void RemPort(struct MsgPort* port) {
+    (void)port;
+}
+
+void _HostPutMsg_Locked(struct MsgPort* port, struct Message* message) {
+    // Exec would corrupt the list if a message was queued twice.  Be kinder
+    // than that so a driver bug shows up as a stall rather than a crash
+    for (struct Node* node = port->mp_MsgList.lh_Head; node->ln_Succ; node = node->ln_Succ)
+        if (node == &message->mn_Node) {
+            Remove(node);
+            break;
+        }
+    message->mn_Node.ln_Type = NT_MESSAGE;
+    AddTail(&port->mp_MsgList, &message->mn_Node);
+    // Ports created on the stack don't always set mp_Flags, so treat any port
+    // with a task attached as PA_SIGNAL
+    if (port->mp_SigTask) _HostSignal_Locked((struct Task*)port->mp_SigTask, 1UL << port->mp_SigBit);
+}
+
+void PutMsg(struct MsgPort* port, struct Message* message) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    _HostPutMsg_Locked(port, message);
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+struct Message* GetMsg(struct MsgPort* port) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    struct Message* message = (struct Message*)RemHead(&port->mp_MsgList);
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return message;
+}
+
+void _HostReplyMsg_Locked(struct Message* message) {
+    if (message->mn_ReplyPort) {
+        _HostPutMsg_Locked(message->mn_ReplyPort, message);
+        message->mn_Node.ln_Type = NT_REPLYMSG;
+    } else message->mn_Node.ln_Type = NT_FREEMSG;
+}
+
+void ReplyMsg(struct Message* message) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    _HostReplyMsg_Locked(message);
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+struct Message* WaitPort(struct MsgPort* port) {
+    for (;;) {
+        pthread_mutex_lock(&_HostExec_Lock);
+        struct Message* message = (struct Message*)port->mp_MsgList.lh_Head;
+        if (!message->mn_Node.ln_Succ) message = NULL;
+        pthread_mutex_unlock(&_HostExec_Lock);
+        if (message) return message;
+        Wait(1UL << port->mp_SigBit);
+    }
+}
+
+/****************************************************************************/
+/* Devices and IO                                                           */
+/****************************************************************************/
+
+void HostSCSI_SetBackend(const struct HostSCSIBackend* backend) {
+    _scsiBackend = *backend;
+}
+
+APTR CreateIORequest(struct MsgPort* port, ULONG size) {
+    if (!port) return NULL;
+    struct IORequest* io = AllocMem(size, MEMF_PUBLIC | MEMF_CLEAR);
+    if (!io) return NULL;
+    io->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+    io->io_Message.mn_ReplyPort = port;
+    io->io_Message.mn_Length = size;
+    return io;
+}
+
+void DeleteIORequest(APTR iorequest) {
+    struct IORequest* io = (struct IORequest*)iorequest;
+    if (!io) return;
+    FreeMem(io, io->io_Message.mn_Length);
+}
+
+BYTE OpenDevice(CONST_STRPTR devName, ULONG unit, struct IORequest* ioRequest, ULONG flags) {
+    (void)flags;
+    ioRequest->io_Error = 0;
+    if (strcmp(devName, TIMERNAME) == 0) {
+        ioRequest->io_Error = _HostTimer_Open(unit, ioRequest);
+    } else {
+        if (!_scsiBackend.command) ioRequest->io_Error = IOERR_OPENFAIL; else
+        if (_scsiBackend.open) ioRequest->io_Error = _scsiBackend.open(_scsiBackend.context, devName, unit);
+        if (!ioRequest->io_Error) {
+            ioRequest->io_Device = &_scsiDevice;
+            ioRequest->io_Unit = (struct Unit*)(IPTR)unit;
+        }
+    }
+    if (ioRequest->io_Error) {
+        ioRequest->io_Device = NULL;
+        ioRequest->io_Unit = NULL;
+    }
+    return ioRequest->io_Error;
+}
+
+void CloseDevice(struct IORequest* ioRequest) {
+    if ((ioRequest->io_Device == &_scsiDevice) && (_scsiBackend.close))
+        _scsiBackend.close(_scsiBackend.context, (ULONG)(IPTR)ioRequest->io_Unit);
+    if (ioRequest->io_Device == &_HostTimer_Device) _HostTimer_Close(ioRequest);
+    ioRequest->io_Device = NULL;
+    ioRequest->io_Unit = NULL;
+}
+
+static void scsiRunCommand(struct IORequest* ioRequest) {
+    struct IOStdReq* std = (struct IOStdReq*)ioRequest;
+    if (ioRequest->io_Command == HD_SCSICMD) {
+        struct SCSICmd* cmd = (struct SCSICmd*)std->io_Data;
+        cmd->scsi_CmdActual = cmd->scsi_CmdLength;
+        ioRequest->io_Error = _scsiBackend.command(_scsiBackend.context, (ULONG)(IPTR)ioRequest->io_Unit, cmd);
+        std->io_Actual = std->io_Length;
+    } else ioRequest->io_Error = IOERR_NOCMD;
+}
+
+// The DMA controller's own task.  Commands run one at a time in the order they were sent
+static void* scsiTask(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&_scsiQueueLock);
+        while (IsListEmpty(&_scsiQueue)) pthread_cond_wait(&_scsiQueueCond, &_scsiQueueLock);
+        struct IORequest* ioRequest = (struct IORequest*)RemHead(&_scsiQueue);
+        pthread_mutex_unlock(&_scsiQueueLock);
+        scsiRunCommand(ioRequest);
+        ReplyMsg(&ioRequest->io_Message);
+    }
+    return NULL;
+}
+
+// A PIO controller completes everything in the calling task, like a controller
+// driver running the command in its BeginIO would.  A DMA one never completes
+// quick, which is what scsi.device and friends do
+static void scsiBeginIO(struct IORequest* ioRequest) {
+    struct IOStdReq* std = (struct IOStdReq*)ioRequest;
+    ioRequest->io_Message.mn_Node.ln_Type = NT_MESSAGE;
+
+    if (ioRequest->io_Command == HD_SCSICMD) {
+        struct SCSICmd* cmd = (struct SCSICmd*)std->io_Data;
+        __atomic_add_fetch(&HostShim_Stats.scsiCommands, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&HostShim_Stats.scsiOpcodes[cmd->scsi_Command[0]], 1, __ATOMIC_RELAXED);
+        if (cmd->scsi_Command[0] == 0x1c)
+            __atomic_add_fetch(&HostShim_Stats.scsiSubOpcodes[cmd->scsi_Command[1]], 1, __ATOMIC_RELAXED);
+    }
+
+    if (_scsiBackend.dma) {
+        ioRequest->io_Flags &= ~IOF_QUICK;
+        pthread_mutex_lock(&_scsiQueueLock);
+        if (!_scsiTaskRunning) {
+            pthread_t thread;
+            NewList(&_scsiQueue);
+            if (pthread_create(&thread, NULL, scsiTask, NULL) == 0) {
+                pthread_detach(thread);
+                _scsiTaskRunning = TRUE;
+            }
+        }
+        if (_scsiTaskRunning) {
+            AddTail(&_scsiQueue, &ioRequest->io_Message.mn_Node);
+            pthread_cond_signal(&_scsiQueueCond);
+            pthread_mutex_unlock(&_scsiQueueLock);
+            return;
+        }
+        pthread_mutex_unlock(&_scsiQueueLock);
+    }
+
+    scsiRunCommand(ioRequest);
+    if (!(ioRequest->io_Flags & IOF_QUICK)) ReplyMsg(&ioRequest->io_Message);
+}
+
+void BeginIO(struct IORequest* ioRequest) {
+    if (ioRequest->io_Device == &_HostTimer_Device) _HostTimer_BeginIO(ioRequest); else
+    if (ioRequest->io_Device == &_scsiDevice) scsiBeginIO(ioRequest); else {
+        ioRequest->io_Error = IOERR_OPENFAIL;
+        if (!(ioRequest->io_Flags & IOF_QUICK)) ReplyMsg(&ioRequest->io_Message);
+    }
+}
+
+BYTE DoIO(struct IORequest* ioRequest) {
+    ioRequest->io_Flags = IOF_QUICK;
+    BeginIO(ioRequest);
+    return WaitIO(ioRequest);
+}
+
+void SendIO(struct IORequest* ioRequest) {
+    ioRequest->io_Flags = 0;
+    BeginIO(ioRequest);
+}
+
+struct IORequest* CheckIO(struct IORequest* ioRequest) {
+    if (ioRequest->io_Flags & IOF_QUICK) return ioRequest;
+    pthread_mutex_lock(&_HostExec_Lock);
+    UBYTE type = ioRequest->io_Message.mn_Node.ln_Type;
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return (type == NT_REPLYMSG) ? ioRequest : NULL;
+}
+
+BYTE WaitIO(struct IORequest* ioRequest) {
+    if (ioRequest->io_Flags & IOF_QUICK) return ioRequest->io_Error;
+
+    struct MsgPort* port = ioRequest->io_Message.mn_ReplyPort;
+    pthread_mutex_lock(&_HostExec_Lock);
+    while (ioRequest->io_Message.mn_Node.ln_Type != NT_REPLYMSG) {
+        pthread_mutex_unlock(&_HostExec_Lock);
+        Wait(1UL << port->mp_SigBit);
+        pthread_mutex_lock(&_HostExec_Lock);
+    }
+    for (struct Node* node = port->mp_MsgList.lh_Head; node->ln_Succ; node = node->ln_Succ)
+        if (node == &ioRequest->io_Message.mn_Node) {
+            Remove(node);
+            break;
+        }
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return ioRequest->io_Error;
+}
+
+void AbortIO(struct IORequest* ioRequest) {
+    if (ioRequest->io_Device == &_HostTimer_Device) _HostTimer_AbortIO(ioRequest);
+    // SCSI commands can't be aborted once queued, they just run to completion
+}
+
+/****************************************************************************/
+/* Libraries                                                                */
+/****************************************************************************/
+
+static struct Library _libraries[8];
+static const char* _libraryNames[8];
+
+struct Library* OpenLibrary(CONST_STRPTR libName, ULONG version) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    struct Library* lib = NULL;
+    for (int i = 0; i < 8; i++) {
+        if ((!_libraryNames[i]) || (strcmp(_libraryNames[i], libName) == 0)) {
+            _libraryNames[i] = libName;
+            lib = &_libraries[i];
+            lib->lib_Node.ln_Name = (char*)libName;
+            lib->lib_Node.ln_Type = NT_LIBRARY;
+            lib->lib_Version = (version > 40) ? version : 40;
+            lib->lib_OpenCnt++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_HostExec_Lock);
+    return lib;
+}
+
+void CloseLibrary(struct Library* library) {
+    if (library) library->lib_OpenCnt--;
+}
+
+/****************************************************************************/
+/* utility.library                                                          */
+/****************************************************************************/
+
+struct TagItem* NextTagItem(struct TagItem** tagListPtr) {
+    struct TagItem* tag = *tagListPtr;
+    while (tag) {
+        switch (tag->ti_Tag) {
+            case TAG_DONE:   *tagListPtr = NULL; return NULL;
+            case TAG_MORE:   tag = (struct TagItem*)tag->ti_Data; continue;
+            case TAG_IGNORE: tag++; continue;
+            case TAG_SKIP:   tag += tag->ti_Data + 1; continue;
+            default:         *tagListPtr = tag + 1; return tag;
+        }
+    }
+    *tagListPtr = NULL;
+    return NULL;
+}
+
+struct TagItem* FindTagItem(Tag tagValue, const struct TagItem* tagList) {
+    struct TagItem* state = (struct TagItem*)tagList;
+    struct TagItem* tag;
+    while ((tag = NextTagItem(&state)))
+        if (tag->ti_Tag == tagValue) return tag;
+    return NULL;
+}
+
+IPTR GetTagData(Tag tagValue, IPTR defaultVal, const struct TagItem* tagList) {
+    struct TagItem* tag = FindTagItem(tagValue, tagList);
+    return tag ? tag->ti_Data : defaultVal;
+}
+
+UBYTE ToUpper(ULONG character) {
+    if ((character >= 'a') && (character <= 'z')) return (UBYTE)(character - 32);
+    return (UBYTE)character;
+}
+
+// Hooks are called with the hook, object and message in A0, A2 and A1.  Here they're just arguments
+IPTR CallHookPkt(struct Hook* hook, APTR object, APTR message) {
+    return ((IPTR (*)(struct Hook*, APTR, APTR))hook->h_Entry)(hook, object, message);
+}
+
+LONG Strnicmp(CONST_STRPTR string1, CONST_STRPTR string2, LONG length) {
+    while (length-- > 0) {
+        UBYTE a = ToUpper((UBYTE)*string1++);
+        UBYTE b = ToUpper((UBYTE)*string2++);
+        if (a != b) return (LONG)a - (LONG)b;
+        if (!a) break;
+    }
+    return 0;
+}
+
+LONG Stricmp(CONST_STRPTR string1, CONST_STRPTR string2) {
+    return Strnicmp(string1, string2, 0x7FFFFFFF);
+}
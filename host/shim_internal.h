@@ -0,0 +1,38 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - shared between the shim modules only
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+#ifndef SHIM_INTERNAL_H
+#define SHIM_INTERNAL_H 1
+
+#include "amiga_host.h"
+
+// The one big lock.  Exec uses Disable()/Forbid() to protect message ports and
+// signal state, we use this.  Never hold it while calling driver code.
+extern pthread_mutex_t _HostExec_Lock;
+
+// Returns the Task for the calling thread, creating one if this thread has
+// never been seen before (eg: main())
+struct Task* _HostTask_Current(void);
+// Sets up the host side of a Task, and binds a Task to the calling thread
+void _HostTask_Init(struct Task* task, UBYTE type);
+void _HostTask_Adopt(struct Task* task);
+
+// Versions of the Exec calls for use with _HostExec_Lock already held
+void _HostSignal_Locked(struct Task* task, ULONG signalSet);
+void _HostPutMsg_Locked(struct MsgPort* port, struct Message* message);
+void _HostReplyMsg_Locked(struct Message* message);
+
+// timer.device (shim_timer.c)
+extern struct Device _HostTimer_Device;
+BYTE _HostTimer_Open(ULONG unit, struct IORequest* ioRequest);
+void _HostTimer_BeginIO(struct IORequest* ioRequest);
+void _HostTimer_AbortIO(struct IORequest* ioRequest);
+void _HostTimer_Close(struct IORequest* ioRequest);
+// Completes any expired requests.  Returns the next deadline (HostShim_Micros
+// time) or 0 if nothing is pending.  Lock must be held.
+uint64_t _HostTimer_Run_Locked(void);
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - timer.device
+ *
+ * UNIT_VBLANK is rounded up to the next 50Hz tick, just like the real thing,
+ * as the granularity of that unit is a big part of how frame_proc behaves.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <time.h>
+#include "shim_internal.h"
+
+#define VBLANK_MICROS       20000ULL
+#define ECLOCK_FREQUENCY    709379UL     // PAL
+#define AMIGA_EPOCH_OFFSET  252460800UL  // 1970 -> 1978
+
+struct Device _HostTimer_Device;
+
+// A request sitting in the timer.  Kept apart from the IORequest so that
+// nothing in the caller's struct is touched while it's queued
+struct PendingTimer {
+    struct PendingTimer* next;
+    struct IORequest* io;
+    uint64_t deadline;
+};
+
+static struct PendingTimer* _pending = NULL;
+
+void GetSysTime(struct timeval* dest) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    dest->tv_secs = (ULONG)(ts.tv_sec - AMIGA_EPOCH_OFFSET);
+    dest->tv_micro = (ULONG)(ts.tv_nsec / 1000);
+}
+
+ULONG ReadEClock(struct EClockVal* dest) {
+    uint64_t ticks = (HostShim_Micros() * ECLOCK_FREQUENCY) / 1000000ULL;
+    dest->ev_hi = (ULONG)(ticks >> 32);
+    dest->ev_lo = (ULONG)ticks;
+    return ECLOCK_FREQUENCY;
+}
+
+void AddTime(struct timeval* dest, struct timeval* src) {
+    dest->tv_secs += src->tv_secs;
+    dest->tv_micro += src->tv_micro;
+    if (dest->tv_micro >= 1000000UL) {
+        dest->tv_micro -= 1000000UL;
+        dest->tv_secs++;
+    }
+}
+
+void SubTime(struct timeval* dest, struct timeval* src) {
+    if (dest->tv_micro < src->tv_micro) {
+        dest->tv_micro += 1000000UL;
+        dest->tv_secs--;
+    }
+    dest->tv_micro -= src->tv_micro;
+    dest->tv_secs -= src->tv_secs;
+}
+
+// Returns 0 if equal, -1 if src > dest, 1 if src < dest (yes, really)
+LONG CmpTime(struct timeval* dest, struct timeval* src) {
+    if (dest->tv_secs != src->tv_secs) return (dest->tv_secs < src->tv_secs) ? -1 : 1;
+    if (dest->tv_micro != src->tv_micro) return (dest->tv_micro < src->tv_micro) ? -1 : 1;
+    return 0;
+}
+
+BYTE _HostTimer_Open(ULONG unit, struct IORequest* ioRequest) {
+    if (unit > UNIT_WAITECLOCK) return IOERR_OPENFAIL;
+    ioRequest->io_Device = &_HostTimer_Device;
+    ioRequest->io_Unit = (struct Unit*)(IPTR)unit;
+    return 0;
+}
+
+static void removePending_Locked(struct IORequest* ioRequest, BYTE error) {
+    for (struct PendingTimer** p = &_pending; *p; p = &(*p)->next) {
+        if ((*p)->io == ioRequest) {
+            struct PendingTimer* item = *p;
+            *p = item->next;
+            free(item);
+            ioRequest->io_Error = error;
+            _HostReplyMsg_Locked(&ioRequest->io_Message);
+            return;
+        }
+    }
+}
+
+void _HostTimer_BeginIO(struct IORequest* ioRequest) {
+    struct timerequest* tr = (struct timerequest*)ioRequest;
+    ioRequest->io_Error = 0;
+
+    switch (ioRequest->io_Command) {
+        case TR_GETSYSTIME:
+            GetSysTime(&tr->tr_time);
+            break;
+
+        case TR_ADDREQUEST: {
+            uint64_t now = HostShim_Micros();
+            uint64_t delay = ((uint64_t)tr->tr_time.tv_secs * 1000000ULL) + tr->tr_time.tv_micro;
+            uint64_t deadline;
+            switch ((ULONG)(IPTR)ioRequest->io_Unit) {
+                case UNIT_VBLANK:
+                    deadline = now + delay;
+                    deadline = ((deadline + VBLANK_MICROS - 1) / VBLANK_MICROS) * VBLANK_MICROS;
+                    break;
+                case UNIT_WAITUNTIL: {
+                    struct timeval sys;
+                    GetSysTime(&sys);
+                    uint64_t sysNow = ((uint64_t)sys.tv_secs * 1000000ULL) + sys.tv_micro;
+                    deadline = now + ((delay > sysNow) ? (delay - sysNow) : 0);
+                    break;
+                }
+                case UNIT_ECLOCK:
+                    deadline = now + (delay * 1000000ULL) / ECLOCK_FREQUENCY;
+                    break;
+                default:
+                    deadline = now + delay;
+                    break;
+            }
+
+            struct PendingTimer* item = malloc(sizeof(struct PendingTimer));
+            item->io = ioRequest;
+            item->deadline = deadline;
+            ioRequest->io_Flags &= ~IOF_QUICK;
+            ioRequest->io_Message.mn_Node.ln_Type = NT_MESSAGE;
+            __atomic_add_fetch(&HostShim_Stats.timerRequests, 1, __ATOMIC_RELAXED);
+
+            pthread_mutex_lock(&_HostExec_Lock);
+            // Sending a request that's already queued would corrupt Exec's lists. Treat it as a restart.
+            for (struct PendingTimer** p = &_pending; *p; p = &(*p)->next)
+                if ((*p)->io == ioRequest) {
+                    struct PendingTimer* old = *p;
+                    *p = old->next;
+                    free(old);
+                    break;
+                }
+            item->next = _pending;
+            _pending = item;
+            pthread_mutex_unlock(&_HostExec_Lock);
+            return;
+        }
+
+        default:
+            ioRequest->io_Error = IOERR_NOCMD;
+            break;
+    }
+
+    if (!(ioRequest->io_Flags & IOF_QUICK)) ReplyMsg(&ioRequest->io_Message);
+}
+
+void _HostTimer_AbortIO(struct IORequest* ioRequest) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    removePending_Locked(ioRequest, IOERR_ABORTED);
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+// Closing with a request still queued would leave timer.device replying to a
+// port that has probably gone.  Quietly forget it instead.
+void _HostTimer_Close(struct IORequest* ioRequest) {
+    pthread_mutex_lock(&_HostExec_Lock);
+    for (struct PendingTimer** p = &_pending; *p; p = &(*p)->next) {
+        if ((*p)->io == ioRequest) {
+            struct PendingTimer* item = *p;
+            *p = item->next;
+            free(item);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_HostExec_Lock);
+}
+
+uint64_t _HostTimer_Run_Locked(void) {
+    uint64_t now = HostShim_Micros();
+    uint64_t next = 0;
+    struct PendingTimer** p = &_pending;
+    while (*p) {
+        struct PendingTimer* item = *p;
+        if (item->deadline <= now) {
+            *p = item->next;
+            item->io->io_Error = 0;
+            _HostReplyMsg_Locked(&item->io->io_Message);
+            free(item);
+        } else {
+            if ((!next) || (item->deadline < next)) next = item->deadline;
+            p = &item->next;
+        }
+    }
+    return next;
+}
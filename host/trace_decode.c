@@ -0,0 +1,165 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Host (Linux) build support - decodes an S2_DAYNA_TRACE dump
+ *
+ * Reads a dump saved by tracedump (on the Amiga, big endian) or by
+ * bench_frameproc -D (here, host endian) and reports how long each stage of
+ * the hot path took, or with -t prints the whole timeline.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <exec/io.h>
+#include "trace.h"
+
+static const char* eventNames[teCount] = {
+    "-", "ScsiSubmit", "ScsiComplete", "BeginIO", "TermIO", "RxLoop", "RxFrames",
+    "ReadCopy", "ReadCopied", "TxLoop", "WriteCopy", "WriteCopied", "Wait", "Wake"
+};
+
+// A stage runs from one event to another, matched on the request when byRequest is set
+struct Stage {
+    const char* name;
+    UWORD from, to;
+    BOOL byRequest;
+    ULONG count;
+    double total, max;
+};
+
+static struct Stage stages[] = {
+    {"SCSI command, sent to finished",      teScsiSubmit,   teScsiComplete, TRUE},
+    {"CMD_WRITE, queued to copied from",    teBeginIO,      teWriteCopy,    TRUE},
+    {"CMD_WRITE, copying from the stack",   teWriteCopy,    teWriteCopied,  TRUE},
+    {"CMD_WRITE, sent to replied",          teWriteCopied,  teTermIO,       TRUE},
+    {"received buffer to first copy",       teRxFrames,     teReadCopy,     FALSE},
+    {"CMD_READ, copying to the stack",      teReadCopy,     teReadCopied,   TRUE},
+    {"CMD_READ, copied to replied",         teReadCopied,   teTermIO,       TRUE},
+    {"frame_proc asleep",                   teWait,         teWake,         FALSE},
+};
+#define STAGE_COUNT (sizeof(stages) / sizeof(stages[0]))
+
+static BOOL swapped;
+
+static ULONG get32(ULONG v) { return swapped ? __builtin_bswap32(v) : v; }
+static UWORD get16(UWORD v) { return swapped ? __builtin_bswap16(v) : v; }
+
+static void usage(const char* name) {
+    printf("Usage: %s [-t] tracefile\n"
+           "  -t prints every event instead of the per stage times\n", name);
+}
+
+int main(int argc, char** argv) {
+    BOOL timeline = FALSE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "th")) != -1) {
+        switch (opt) {
+            case 't': timeline = TRUE; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    struct TraceDumpHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1) {
+        printf("%s: too short\n", argv[optind]);
+        fclose(f);
+        return 1;
+    }
+    if (header.th_Magic != TRACE_MAGIC) {
+        swapped = TRUE;
+        if (get32(header.th_Magic) != TRACE_MAGIC) {
+            printf("%s: not a trace dump\n", argv[optind]);
+            fclose(f);
+            return 1;
+        }
+    }
+    ULONG count = get32(header.th_Count), rate = get32(header.th_EClockRate);
+    struct TraceRecord* records = calloc(count ? count : 1, sizeof(struct TraceRecord));
+    if ((!records) || (fread(records, sizeof(struct TraceRecord), count, f) != count)) {
+        printf("%s: truncated\n", argv[optind]);
+        fclose(f);
+        free(records);
+        return 1;
+    }
+    fclose(f);
+    for (ULONG i = 0; i < count; i++) {
+        records[i].tr_Time = get32(records[i].tr_Time);
+        records[i].tr_Arg = get32(records[i].tr_Arg);
+        records[i].tr_Request = get32(records[i].tr_Request);
+        records[i].tr_Event = get16(records[i].tr_Event);
+        records[i].tr_Task = get16(records[i].tr_Task);
+    }
+    if (!rate) rate = 1000000;
+    double microsPerTick = 1000000.0 / rate;
+
+    printf("%lu events (%lu lost before them), EClock %lu Hz, %s endian\n", (unsigned long)count,
+           (unsigned long)get32(header.th_Lost), (unsigned long)rate, swapped ? "opposite" : "host");
+    if (!count) {
+        free(records);
+        return 0;
+    }
+
+    if (timeline) {
+        // The EClock low word wraps, so each time is taken relative to the one before
+        double at = 0;
+        for (ULONG i = 0; i < count; i++) {
+            if (i) at += (ULONG)(records[i].tr_Time - records[i - 1].tr_Time) * microsPerTick;
+            UWORD event = records[i].tr_Event < teCount ? records[i].tr_Event : teNone;
+            printf("%12.1f  %04x  %-12s  arg %08lx  request %08lx\n", at, records[i].tr_Task, eventNames[event],
+                   (unsigned long)records[i].tr_Arg, (unsigned long)records[i].tr_Request);
+        }
+        free(records);
+        return 0;
+    }
+
+    // For each stage, look forward from every start event for its end event
+    for (ULONG s = 0; s < STAGE_COUNT; s++) {
+        struct Stage* stage = &stages[s];
+        for (ULONG i = 0; i < count; i++) {
+            if (records[i].tr_Event != stage->from) continue;
+            // CMD_WRITE stages start with a BeginIO of a CMD_WRITE, and CMD_READ ones end with its TermIO
+            if ((stage->from == teBeginIO) && (records[i].tr_Arg != CMD_WRITE)) continue;
+            for (ULONG j = i + 1; j < count; j++) {
+                if ((records[j].tr_Event == stage->from) && ((!stage->byRequest) || (records[j].tr_Request == records[i].tr_Request))) break;
+                if (records[j].tr_Event != stage->to) continue;
+                if ((stage->byRequest) && (records[j].tr_Request != records[i].tr_Request)) continue;
+                double micros = (ULONG)(records[j].tr_Time - records[i].tr_Time) * microsPerTick;
+                stage->count++;
+                stage->total += micros;
+                if (micros > stage->max) stage->max = micros;
+                break;
+            }
+        }
+    }
+
+    printf("%-36s %8s %12s %12s\n", "Stage", "count", "average us", "max us");
+    for (ULONG s = 0; s < STAGE_COUNT; s++) {
+        struct Stage* stage = &stages[s];
+        printf("%-36s %8lu %12.1f %12.1f\n", stage->name, (unsigned long)stage->count,
+               stage->count ? stage->total / stage->count : 0.0, stage->max);
+    }
+
+    ULONG events[teCount];
+    memset(events, 0, sizeof(events));
+    for (ULONG i = 0; i < count; i++) if (records[i].tr_Event < teCount) events[records[i].tr_Event]++;
+    printf("\nEvents:");
+    for (int e = 1; e < teCount; e++) printf(" %s %lu", eventNames[e], (unsigned long)events[e]);
+    printf("\n");
+
+    free(records);
+    return 0;
+}
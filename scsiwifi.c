@@ -11,12 +11,15 @@
 #include <proto/dos.h>
 #include <proto/utility.h>
 #include <devices/scsidisk.h>
+#include <devices/timer.h>
+#include <proto/timer.h>
 #include <string.h>
 #include "macros.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include "debug.h"
 #include "scsiwifi.h"
+#include "trace.h"
 
 
 #define SCSI_INQUIRY                        0x12
@@ -37,10 +40,16 @@
 #define SCSI_NETWORK_WIFI_OPT_ALTREAD       0x08    
 #define SCSI_NETWORK_WIFI_OPT_GETMACADDRESS 0x09    
 
+// Vendor specific bit in the control byte of a READ or WRITE FRAME for several frames at once
+#define SCSI_NETWORK_WIFI_READ_BATCHED      0x40
+#define SCSI_NETWORK_WIFI_WRITE_BATCHED     0x40
+// WRITE FRAME control byte bit: each frame is preceded by a 4 byte header
+#define SCSI_NETWORK_WIFI_WRITE_HEADER      0x80
+
 #define INQUIRE_BUFFER_SIZE                 64
 
-#define NUM_TOKENS 7
-static char* CONFIG_TOKENS[NUM_TOKENS] = {"DEVICE","DEVICEID","PRIORITY","MODE","AUTOCONNECT","SSID","KEY"};
+#define NUM_TOKENS 12
+static char* CONFIG_TOKENS[NUM_TOKENS] = {"DEVICE","DEVICEID","PRIORITY","MODE","AUTOCONNECT","SSID","KEY","TXWINDOW","POLLMAX","RXPOOL","LINGER","BATCH"};
 
 // Prepares the SCSI command and resets some of the result values
 #define SCSI_PREPCMD(device, cmd, sub, a, b, c, d) \
@@ -50,8 +59,29 @@ static char* CONFIG_TOKENS[NUM_TOKENS] = {"DEVICE","DEVICEID","PRIORITY","MODE",
                 device->Cmd.scsi_SenseActual = 0; device->Cmd.scsi_Actual = 0;  \
                 device->Cmd.scsi_Status = 1;   // Default to error
 
+// One background transfer: its own request, command and receive buffer
+struct SCSITransfer {
+    struct IOStdReq* SCSIReq;
+    struct SCSICmd Cmd;
+    char senseData[20];
+    UBYTE scsiCommand[12];
+    UBYTE* buffer;         // SCSIWIFI_RECEIVE_BUFFER_SIZE bytes, on the transport's alignment
+    UBYTE* allocated;      // where buffer really starts, for FreeVec
+    UWORD allocation;      // size asked for
+    UBYTE busy;            // sent and not yet collected
+    UBYTE batched;         // asked for several frames
+    ULONG started;         // EClock (low word) when it was sent, if commands are being timed
+};
+
 // Internal SCSI device data
 struct SCSIDevice {
+    // Scratch for the commands sent on SCSIReq, so none of them allocate.  First, so it's long aligned
+    union {
+        UBYTE inquiry[INQUIRE_BUFFER_SIZE];
+        UBYTE network[sizeof(struct SCSIWifi_NetworkEntry) + 2];    // 2 byte size, then the entry
+    } scratch;
+    UBYTE scsiCommand[12];  // 6 bytes for the command, 6 used by some of the replies
+
     struct ExecBase *sc_SysBase;
     struct UtilityBase *sc_UtilityBase;
     struct DosBase *sc_dosBase;
@@ -60,12 +90,37 @@ struct SCSIDevice {
     struct SCSICmd Cmd;
     char senseData[20];
     USHORT scsiMode;
-    UBYTE* scsiCommand;    // buffer to hold command, 16-bit aligned (12 bytes)
+    struct SCSIWifi_Transport* transport;   // chosen by SCSIWifi_open
+    UBYTE readCommand[3];  // the first 3 bytes of the READ for scsiMode, see _SCSIWifi_setReadCommand
+    UWORD singleAllocation; // READ allocations for one frame and for a batch, as the transport wants them
+    UWORD batchAllocation;
+    USHORT batchReads;     // 1 until the firmware refuses a batched READ
+    USHORT batchConfirmed; // 1 once the firmware has actually batched a READ
+    struct SCSITransfer transfers[SCSIWIFI_ASYNC_TRANSFERS];
+    USHORT nextStart;      // next transfer to send
+    USHORT nextCollect;    // oldest transfer still to be collected
+    struct Library* sc_TimerBase;               // both set if commands are being timed
+    struct SCSIWifi_CommandTimes* commandTimes;
+    struct TraceRing* trace;
+    char signature[SCSIWIFI_SIGNATURE_SIZE+1];  // from the INQUIRY
+    struct timerequest calibrateTimer;          // SCSIWifi_calibrate's, so it doesn't allocate either
+    USHORT wedged;         // a calibration READ never came back, so the driver still owns our port and buffers
+};
+
+// One ID being probed by SCSIWifi_findDevice
+struct SCSIProbe {
+    UBYTE inquiry[INQUIRE_BUFFER_SIZE];     // first, so it's long aligned
+    UBYTE scsiCommand[12];
+    char senseData[20];
+    struct SCSICmd Cmd;
+    struct IOStdReq* SCSIReq;
+    UBYTE busy;            // INQUIRY sent and not yet collected
 };
 
 #define SysBase dev->sc_SysBase
 #define UtilityBase dev->sc_UtilityBase
 #define DOSBase dev->sc_dosBase
+#define TimerBase dev->sc_TimerBase
 
 typedef struct SCSIDevice* LSCSIDevice;
 
@@ -185,10 +240,15 @@ void SCSIWifi_defaultSettings(struct ScsiDaynaSettings* settings) {
     strcpy(settings->deviceName, "scsi.device");
     settings->deviceID = -1;  // auto detect
     settings->taskPriority = 0;  // -128 to 127  - probably should be 0 but works faster set as 1!
-    settings->scsiMode = 1;      // Driver mode. 0=DynaPORT, 1=24 Byte Patch (scsi.device), 2=Single Write Mode (gvpscsi.device)
+    settings->scsiMode = SCSIWIFI_MODE_AUTO;   // Driver mode. 0=DynaPORT, 1=24 Byte Patch (scsi.device), 2=Single Write Mode (gvpscsi.device)
     settings->autoConnect = 0;   // auto connect to the WIFI?
     strcpy(settings->ssid, "");
     strcpy(settings->key, "");
+    settings->txWindow = 0;      // don't hold frames back
+    settings->pollMax = SCSIWIFI_POLL_MAX_DEFAULT;   // from the SCSI driver's transport
+    settings->rxPool = SCSIWIFI_RX_POOL_DEFAULT;
+    settings->linger = SCSIWIFI_LINGER_DEFAULT;
+    settings->batch = 0;         // one frame per READ and WRITE FRAME, as the shipping firmware does
 }
 
 // Loads settings from the ENV, returns 0 if the settings were bad and defaults were setup
@@ -198,7 +258,6 @@ LONG SCSIWifi_loadSettings(void *utilityBase, void* dosBase, struct ScsiDaynaSet
     devTmp.sc_dosBase = dosBase;
     devTmp.sc_UtilityBase = utilityBase;
 
-    USHORT modeConfigured = 0;
     SCSIWifi_defaultSettings(settings);
     BPTR fh;
     if (fh = Open("ENV:scsidayna.prefs",MODE_OLDFILE)) {
@@ -218,13 +277,25 @@ LONG SCSIWifi_loadSettings(void *utilityBase, void* dosBase, struct ScsiDaynaSet
                                     if (settings->taskPriority>127) settings->taskPriority = 127;
                                     if (settings->taskPriority<-128) settings->taskPriority = -128;
                                     break;
-                            case 3: settings->scsiMode = _atous(value); 
-                                    if (settings->scsiMode>2) settings->scsiMode=2;
-                                    modeConfigured = 1;
+                            case 3: if (_atos(value) < 0) settings->scsiMode = SCSIWIFI_MODE_AUTO; else {
+                                        settings->scsiMode = _atous(value); 
+                                        if (settings->scsiMode>2) settings->scsiMode=2;
+                                    }
                                     break;
                             case 4: settings->autoConnect = _atous(value); break;
                             case 5: strcpy_s(settings->ssid, value, 64); break;
                             case 6: strcpy_s(settings->key, value, 64); break;
+                            case 7: settings->txWindow = _atous(value); break;
+                            case 8: settings->pollMax = _atous(value);
+                                    if (settings->pollMax > SCSIWIFI_POLL_MAX_LIMIT) settings->pollMax = SCSIWIFI_POLL_MAX_LIMIT;
+                                    break;
+                            case 9: settings->rxPool = _atous(value);
+                                    if (settings->rxPool > SCSIWIFI_RX_POOL_LIMIT) settings->rxPool = SCSIWIFI_RX_POOL_LIMIT;
+                                    break;
+                            case 10: settings->linger = _atous(value);
+                                    if (settings->linger > SCSIWIFI_LINGER_LIMIT) settings->linger = SCSIWIFI_LINGER_LIMIT;
+                                    break;
+                            case 11: settings->batch = _atous(value) ? 1 : 0; break;
                             default: matches--; break;
                         }
                         break;
@@ -237,14 +308,46 @@ LONG SCSIWifi_loadSettings(void *utilityBase, void* dosBase, struct ScsiDaynaSet
         return matches > 0;
     }
 
-    // If no mode was set, but a GVP device was specified then jump to mode 2. It will default to 1 anyway
-    if (!modeConfigured) {
-        if ((ToUpper(settings->deviceName[0]) == 'G') && (ToUpper(settings->deviceName[0]) == 'V') && (ToUpper(settings->deviceName[0]) == 'P')) settings->scsiMode = 2;
-    }
-
     return 0;
 }
 
+// What's known about each SCSI driver.  scsi.device (and the A3000/A4000 second bus) can't take the plain READ's short
+// transfers, and gvpscsi.device any but a full one, which makes each idle poll cost the whole allocation so it polls
+// less often.  It also DMAs in 24 bits, so its buffers go there rather than through its bounce buffer.  The
+// accelerator SCSI drivers DMA in longs, and which READ variant they manage varies with the firmware, so they calibrate.
+// unsafeModes are the variants a driver is known to hang on rather than fail, so a calibration never sends them
+static struct SCSIWifi_Transport transports[] = {
+    // driverName           scsiMode            round  maxTransfer                   align  memoryType                     pollMax unsafeModes
+    {"scsi.device",         1,                  2,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 4,     MEMF_PUBLIC,                   50,     SCSIWIFI_MODEF(0)},
+    {"2nd.scsi.device",     1,                  2,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 4,     MEMF_PUBLIC,                   50,     SCSIWIFI_MODEF(0)},
+    {"gvpscsi.device",      2,                  2,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 4,     MEMF_PUBLIC | MEMF_24BITDMA,   100,    SCSIWIFI_MODEF(0) | SCSIWIFI_MODEF(1)},
+    {"2060scsi.device",     SCSIWIFI_MODE_AUTO, 4,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 16,    MEMF_PUBLIC,                   50,     0},
+    {"1230scsi.device",     SCSIWIFI_MODE_AUTO, 4,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 16,    MEMF_PUBLIC,                   50,     0},
+    {"ematscsi.device",     SCSIWIFI_MODE_AUTO, 4,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 4,     MEMF_PUBLIC,                   50,     0},
+    {NULL,                  SCSIWIFI_MODE_AUTO, 2,     SCSIWIFI_RECEIVE_BUFFER_SIZE, 4,     MEMF_PUBLIC,                   50,     0}
+};
+
+struct SCSIWifi_Transport* SCSIWifi_findTransport(void *utilityBase, char* deviceName) {
+    struct SCSIDevice devTmp;
+    LSCSIDevice dev = &devTmp;
+    struct SCSIWifi_Transport* transport;
+    char* name = deviceName;
+    devTmp.sc_UtilityBase = utilityBase;
+
+    // Just the name, without DEVS: or a path
+    for (char* c = deviceName; *c; c++)
+        if ((*c == ':') || (*c == '/')) name = c + 1;
+    for (transport = transports; transport->driverName; transport++)
+        if (Stricmp(name, transport->driverName) == 0) break;
+    return transport;
+}
+
+USHORT SCSIWifi_guessMode(void *utilityBase, char* deviceName) {
+    USHORT scsiMode = SCSIWifi_findTransport(utilityBase, deviceName)->scsiMode;
+    // Anything not known is probably scsi.device alike
+    return (scsiMode == SCSIWIFI_MODE_AUTO) ? 1 : scsiMode;
+}
+
 // Saves settings back to ENV or ENVARC
 LONG SCSIWifi_saveSettings(struct DosBase *dosBase, struct ScsiDaynaSettings* settings, LONG saveToENV) {
     struct SCSIDevice devTmp;
@@ -256,18 +359,25 @@ LONG SCSIWifi_saveSettings(struct DosBase *dosBase, struct ScsiDaynaSettings* se
         USHORT good = 1;
         char tmp[20];  // temp buffer
         for (USHORT token = 0; token < NUM_TOKENS; token++) {
-            if (!FPuts(fh, CONFIG_TOKENS[token])) good = 0;
-            if (!FPuts(fh, "=")) good = 0;
+            if (FPuts(fh, CONFIG_TOKENS[token])) good = 0;
+            if (FPuts(fh, "=")) good = 0;
             switch (token) {
-                case 0:  if (!FPuts(fh, settings->deviceName)) good = 0; break;
-                case 1:  _stoa(settings->deviceID, tmp);  if (!FPuts(fh, tmp)) good = 0; break;
-                case 2:  _stoa(settings->taskPriority, tmp);  if (!FPuts(fh, tmp)) good = 0; break;
-                case 3:  _ustoa(settings->scsiMode, tmp);  if (!FPuts(fh, tmp)) good = 0; break;
-                case 4:  _ustoa(settings->autoConnect, tmp);  if (!FPuts(fh, tmp)) good = 0; break;
-                case 5:  if (!FPuts(fh, settings->ssid)) good = 0; break;
-                case 6:  if (!FPuts(fh, settings->key)) good = 0; break;
+                case 0:  if (FPuts(fh, settings->deviceName)) good = 0; break;
+                case 1:  _stoa(settings->deviceID, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 2:  _stoa(settings->taskPriority, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 3:  if (settings->scsiMode == SCSIWIFI_MODE_AUTO) _stoa(-1, tmp); else _ustoa(settings->scsiMode, tmp);
+                         if (FPuts(fh, tmp)) good = 0;
+                         break;
+                case 4:  _ustoa(settings->autoConnect, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 5:  if (FPuts(fh, settings->ssid)) good = 0; break;
+                case 6:  if (FPuts(fh, settings->key)) good = 0; break;
+                case 7:  _ustoa(settings->txWindow, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 8:  _ustoa(settings->pollMax, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 9:  _ustoa(settings->rxPool, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 10: _ustoa(settings->linger, tmp);  if (FPuts(fh, tmp)) good = 0; break;
+                case 11: _ustoa(settings->batch, tmp);  if (FPuts(fh, tmp)) good = 0; break;
             }
-            if (!FPuts(fh, "\n")) good = 0;
+            if (FPuts(fh, "\n")) good = 0;
         }
 
         Close(fh);
@@ -325,18 +435,90 @@ struct MsgPort *_CreatePort(LSCSIDevice dev, UBYTE *name, LONG pri) {
 
 void _DeletePort(LSCSIDevice dev, struct MsgPort *mp) {
     if ( mp->mp_Node.ln_Name ) RemPort(mp);  /* if it was public... */
+    /* A released port's signal has already gone */
+    if ( mp->mp_SigTask ) FreeSignal( mp->mp_SigBit );
 
     mp->mp_SigTask         = (struct Task *) -1;
                             /* Make it difficult to re-use the port */
     mp->mp_MsgList.lh_Head = (struct Node *) -1;
 
-    FreeSignal( mp->mp_SigBit );
     FreeMem( mp, (ULONG)sizeof(struct MsgPort) );
 }
 
+// Which histogram a command's time goes in
+enum SCSIWifi_CommandClass _SCSIWifi_commandClass(UBYTE* command) {
+    if ((command[0] == SCSI_NETWORK_WIFI_READFRAME) || 
+        ((command[0] == SCSI_NETWORK_WIFI_CMD) && (command[1] == SCSI_NETWORK_WIFI_OPT_ALTREAD))) return swccRead;
+    if (command[0] == SCSI_NETWORK_WIFI_WRITEFRAME) return swccWrite;
+    return swccOther;
+}
+
+void SCSIWifi_addTime(struct SCSIWifi_Histogram* histogram, ULONG ticks) {
+    USHORT bucket = 0;
+    ticks >>= SCSIWIFI_HISTOGRAM_SHIFT;
+    while ((ticks) && (bucket < SCSIWIFI_HISTOGRAM_BUCKETS - 1)) {
+        ticks >>= 1;
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+}
+
+// Runs the command in dev->SCSIReq, timing it if asked to
+void _SCSIWifi_doIO(LSCSIDevice dev) {
+    struct EClockVal start, end;
+
+    TRACE(dev->trace, teScsiSubmit, ((ULONG)dev->scsiCommand[0] << 8) | dev->scsiCommand[1], dev->SCSIReq);
+    if (!dev->commandTimes) {
+        DoIO( (struct IORequest*)dev->SCSIReq );
+        TRACE(dev->trace, teScsiComplete, dev->Cmd.scsi_Status ? 0xFFFFFFFF : dev->Cmd.scsi_Actual, dev->SCSIReq);
+        return;
+    }
+    ReadEClock(&start);
+    DoIO( (struct IORequest*)dev->SCSIReq );
+    ReadEClock(&end);
+    TRACE(dev->trace, teScsiComplete, dev->Cmd.scsi_Status ? 0xFFFFFFFF : dev->Cmd.scsi_Actual, dev->SCSIReq);
+    SCSIWifi_addTime(&dev->commandTimes->commands[_SCSIWifi_commandClass(dev->scsiCommand)], end.ev_lo - start.ev_lo);
+}
+
+void SCSIWifi_setTiming(SCSIWIFIDevice device, struct Library* timerBase, struct SCSIWifi_CommandTimes* times) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    dev->sc_TimerBase = timerBase;
+    dev->commandTimes = timerBase ? times : NULL;
+}
+
+void SCSIWifi_setTrace(SCSIWIFIDevice device, struct TraceRing* trace) {
+    ((LSCSIDevice)device)->trace = trace;
+}
+
+// Copies the vendor, product and revision from an INQUIRY reply to signature, then checks it's a DaynaPORT. 
+// This changes inquiry
+LONG _SCSIWifi_checkInquiry(LSCSIDevice dev, UBYTE* inquiry, ULONG actual, char* signature) {
+    USHORT size = 0;
+    if (actual > 8) size = (actual - 8 > SCSIWIFI_SIGNATURE_SIZE) ? SCSIWIFI_SIGNATURE_SIZE : actual - 8;
+    memcpy(signature, &inquiry[8], size);
+    signature[size] = '\0';
+
+    if (actual <= 26) return 0;
+    // A little hacky but will work for us
+    inquiry[13] = '\0';
+    inquiry[25] = '\0';
+    // Check it's the device we're looking for
+    return (Stricmp(&inquiry[8], "Dayna") == 0) && (Stricmp(&inquiry[16], "SCSI/Link") == 0);
+}
+
 // Close and free the open SCSI device
 void _SCSIWifi_close(LSCSIDevice dev) {
     if (!dev) return;
+    // The driver will still reply to the port, and may yet write to the buffer, so all of it is left to it
+    if (dev->wedged) return;
+    for (USHORT i=0; i<SCSIWIFI_ASYNC_TRANSFERS; i++) {
+        struct SCSITransfer* t = &dev->transfers[i];
+        if (t->SCSIReq) {
+            if (t->busy) WaitIO((struct IORequest *)t->SCSIReq);
+            _DeleteExtIO(dev, (struct IORequest *)t->SCSIReq);
+        }
+        if (t->allocated) FreeVec(t->allocated);
+    }
     if (dev->SCSIReq) {
         if (!(CheckIO((struct IORequest *)dev->SCSIReq))) {
             AbortIO((struct IORequest *)dev->SCSIReq);      
@@ -345,11 +527,26 @@ void _SCSIWifi_close(LSCSIDevice dev) {
         CloseDevice((struct IORequest *)dev->SCSIReq);
         _DeleteExtIO(dev, (struct IORequest *)dev->SCSIReq);
     }
-    if (dev->scsiCommand) FreeVec(dev->scsiCommand);
     if (dev->Port) _DeletePort(dev, dev->Port);
     FreeVec(dev);
 }
 
+// Builds the start of the READ for scsiMode once, so each read just copies it
+void _SCSIWifi_setReadCommand(LSCSIDevice dev, USHORT scsiMode) {
+    dev->scsiMode = scsiMode;
+    switch (scsiMode) {
+        case 1:  // scsi.device mode
+            dev->readCommand[0] = SCSI_NETWORK_WIFI_CMD; dev->readCommand[1] = SCSI_NETWORK_WIFI_OPT_ALTREAD; dev->readCommand[2] = 0xA8;
+            break;
+        case 2:  // gvpscsi.device mode
+            dev->readCommand[0] = SCSI_NETWORK_WIFI_CMD; dev->readCommand[1] = SCSI_NETWORK_WIFI_OPT_ALTREAD; dev->readCommand[2] = 0xA9;
+            break;
+        default:
+            dev->readCommand[0] = SCSI_NETWORK_WIFI_READFRAME; dev->readCommand[1] = 0; dev->readCommand[2] = 0;
+            break;
+    }
+}
+
 // Returns NULL on error (or not found), and a valid struct if its the BlueScsi Network Device
 SCSIWIFIDevice SCSIWifi_open(struct SCSIDevice_OpenData* openData, enum SCSIWifi_OpenResult* errorCode) {
     LSCSIDevice dev;
@@ -383,9 +580,6 @@ SCSIWIFIDevice SCSIWifi_open(struct SCSIDevice_OpenData* openData, enum SCSIWifi
             _SCSIWifi_close(dev);
             return NULL;
         }
-        // 6 bytes for command, 6 used by some of the status replies
-        dev->scsiCommand = AllocVec(12, MEMF_PUBLIC|MEMF_CLEAR);
-
         // Open driver
         BYTE err = OpenDevice(openData->deviceDriverName, openData->deviceID, (struct IORequest*)dev->SCSIReq, 0);
         if (err != 0) {
@@ -395,7 +589,12 @@ SCSIWIFIDevice SCSIWifi_open(struct SCSIDevice_OpenData* openData, enum SCSIWifi
             _SCSIWifi_close(dev);
             return NULL;
         }
-        dev->scsiMode = openData->scsiMode;
+        dev->transport = SCSIWifi_findTransport(openData->utilityBase, openData->deviceDriverName);
+        _SCSIWifi_setReadCommand(dev, openData->scsiMode);
+        dev->batchReads = openData->batch ? 1 : 0;
+        // Rounding up is fine for the buffers, but a batch mustn't be bigger than them
+        dev->singleAllocation = (SCSIWIFI_PACKET_MAX_SIZE + 6 + dev->transport->lengthRound - 1) & ~(dev->transport->lengthRound - 1);
+        dev->batchAllocation = dev->transport->maxTransfer & ~(dev->transport->lengthRound - 1);
 
         // Setup the SCSI command structure    
         dev->SCSIReq->io_Length  = sizeof(struct SCSICmd);
@@ -407,46 +606,248 @@ SCSIWIFIDevice SCSIWifi_open(struct SCSIDevice_OpenData* openData, enum SCSIWifi
         dev->Cmd.scsi_SenseData = (UBYTE*)&dev->senseData;     
         dev->Cmd.scsi_SenseLength = 20;              
 
-        UBYTE* tmpBuffer = AllocVec(INQUIRE_BUFFER_SIZE+16, MEMF_PUBLIC);
-        if (!tmpBuffer) {
-            *errorCode = sworOutOfMem;
-            _SCSIWifi_close(dev);
-            return NULL;
+        // The background transfers share the unit and reply port with the main request
+        for (USHORT i=0; i<SCSIWIFI_ASYNC_TRANSFERS; i++) {
+            struct SCSITransfer* t = &dev->transfers[i];
+            t->SCSIReq = (struct IOStdReq*)_CreateExtIO(dev, dev->Port, sizeof(struct IOStdReq));
+            // AllocVec is long aligned, and so, after its 6 byte record header and 14 byte ethernet header, is the data of
+            // the first frame read into it.  Controllers wanting more get the extra to line it up in
+            t->allocated = AllocVec(SCSIWIFI_RECEIVE_BUFFER_SIZE + dev->transport->alignment - 4, dev->transport->memoryType);
+            t->buffer = t->allocated + ((-(IPTR)t->allocated) & (dev->transport->alignment - 1));
+            if ((!t->SCSIReq) || (!t->allocated)) {
+                *errorCode = sworOutOfMem;
+                _SCSIWifi_close(dev);
+                return NULL;
+            }
+            t->SCSIReq->io_Device  = dev->SCSIReq->io_Device;
+            t->SCSIReq->io_Unit    = dev->SCSIReq->io_Unit;
+            t->SCSIReq->io_Length  = sizeof(struct SCSICmd);
+            t->SCSIReq->io_Data    = (APTR)&t->Cmd;
+            t->SCSIReq->io_Command = HD_SCSICMD;
+            t->Cmd.scsi_CmdLength = 6;
+            t->Cmd.scsi_Command   = t->scsiCommand;
+            t->Cmd.scsi_SenseData = (UBYTE*)&t->senseData;
+            t->Cmd.scsi_SenseLength = 20;
         }
+
         SCSI_PREPCMD(dev, SCSI_INQUIRY, 0, 0, 0, INQUIRE_BUFFER_SIZE, 0);    
-        dev->Cmd.scsi_Data = (UWORD*)tmpBuffer;     
+        dev->Cmd.scsi_Data = (UWORD*)dev->scratch.inquiry;     
         dev->Cmd.scsi_Length = INQUIRE_BUFFER_SIZE;        
         dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-        DoIO( (struct IORequest*)dev->SCSIReq );  
+        _SCSIWifi_doIO(dev);
 
         // Failed
         if (dev->Cmd.scsi_Status) {
             *errorCode = sworInquireFail;
-            FreeVec(tmpBuffer);
             _SCSIWifi_close(dev);
             return NULL;
         }
         // Check the result
-        if (dev->Cmd.scsi_Actual > 26) {
-            // A little hacky but will work for us
-            tmpBuffer[13] = '\0';
-            tmpBuffer[25] = '\0';
-            // Check it's the device we're looking for
-            if ((Stricmp(&tmpBuffer[8], "Dayna") == 0) && 
-                (Stricmp(&tmpBuffer[16], "SCSI/Link") == 0)) {
-                FreeVec(tmpBuffer);
-                *errorCode = sworOK;
-                return (SCSIWIFIDevice)dev;
-            }      
-        } 
+        if (_SCSIWifi_checkInquiry(dev, dev->scratch.inquiry, dev->Cmd.scsi_Actual, dev->signature)) {
+            *errorCode = sworOK;
+            return (SCSIWIFIDevice)dev;
+        }
         *errorCode = sworNotDaynaDevice;
-        FreeVec(tmpBuffer);
         _SCSIWifi_close(dev);
     }
     return NULL;
 }
 
+LONG SCSIWifi_adopt(SCSIWIFIDevice device) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    BYTE sigBit = AllocSignal(-1);
+    if (sigBit == -1) return 0;
+    dev->Port->mp_SigBit = sigBit;
+    dev->Port->mp_SigTask = (struct Task *)FindTask(0L);
+    dev->Port->mp_Flags = PA_SIGNAL;
+    return 1;
+}
+
+void SCSIWifi_release(SCSIWIFIDevice device) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    if (!dev->Port->mp_SigTask) return;
+    dev->Port->mp_Flags = PA_IGNORE;
+    dev->Port->mp_SigTask = NULL;
+    FreeSignal(dev->Port->mp_SigBit);
+}
+
+void SCSIWifi_getSignature(SCSIWIFIDevice device, char* signature) {
+    strcpy(signature, ((LSCSIDevice)device)->signature);
+}
+
+// Collects a probe's INQUIRY, returning 1 if it found the DaynaPORT
+LONG _SCSIWifi_collectProbe(LSCSIDevice dev, struct SCSIProbe* probe, char* signature) {
+    WaitIO((struct IORequest*)probe->SCSIReq);
+    probe->busy = 0;
+    if ((probe->SCSIReq->io_Error) || (probe->Cmd.scsi_Status)) return 0;
+    return _SCSIWifi_checkInquiry(dev, probe->inquiry, probe->Cmd.scsi_Actual, signature);
+}
+
+// Waits up to micros for the probes' INQUIRYs, returning the ID of the first to find the DaynaPORT, or -1.
+// Without a timer it only collects those already answered
+LONG _SCSIWifi_waitProbes(LSCSIDevice dev, struct SCSIProbe* probes, struct timerequest* timer, ULONG micros, char* signature) {
+    LONG found = -1;
+    if (timer) {
+        timer->tr_node.io_Command = TR_ADDREQUEST;
+        timer->tr_time.tv_secs = micros / 1000000UL;
+        timer->tr_time.tv_micro = micros % 1000000UL;
+        SendIO((struct IORequest*)timer);
+    }
+    for (;;) {
+        USHORT waiting = 0;
+        for (USHORT i=0; (i<8) && (found < 0); i++) {
+            if (!probes[i].busy) continue;
+            if (!CheckIO((struct IORequest*)probes[i].SCSIReq)) waiting++; 
+            else if (_SCSIWifi_collectProbe(dev, &probes[i], signature)) found = i;
+        }
+        if ((found >= 0) || (!waiting) || (!timer) || (CheckIO((struct IORequest*)timer))) break;
+        Wait(1L << timer->tr_node.io_Message.mn_ReplyPort->mp_SigBit);
+    }
+    if (timer) {
+        if (!CheckIO((struct IORequest*)timer)) AbortIO((struct IORequest*)timer);
+        WaitIO((struct IORequest*)timer);
+    }
+    return found;
+}
+
+LONG SCSIWifi_findDevice(struct SCSIDevice_OpenData* openData, LONG skipID, char* signature) {
+    struct SCSIDevice devTmp;
+    LSCSIDevice dev = &devTmp;
+    devTmp.sc_SysBase = openData->sysBase;
+    devTmp.sc_UtilityBase = openData->utilityBase;
+    devTmp.sc_dosBase = openData->dosBase;
+
+    struct MsgPort* port;
+    struct SCSIProbe* probes;
+    struct timerequest* timer;
+    LONG found = -1;
+    USHORT id;
+
+    if (!(port = _CreatePort(dev, NULL, 0))) return -1;
+    if (!(probes = (struct SCSIProbe*)AllocVec(sizeof(struct SCSIProbe) * 8, MEMF_PUBLIC|MEMF_CLEAR))) {
+        _DeletePort(dev, port);
+        return -1;
+    }
+    // Without the timer nothing is waited for, and an ID is only found if it answers before the next is opened
+    if ((timer = (struct timerequest*)_CreateExtIO(dev, port, sizeof(struct timerequest))) &&
+        (OpenDevice(TIMERNAME, UNIT_VBLANK, (struct IORequest*)timer, 0))) {
+        _DeleteExtIO(dev, (struct IORequest*)timer);
+        timer = NULL;
+    }
+
+    // Highly likely it will be on 4 as its in the example so start there!
+    for (id=4; (id<4+8) && (found < 0); id++) {
+        struct SCSIProbe* probe = &probes[id & 7];
+        if ((id & 7) == skipID) continue;
+        if (!(probe->SCSIReq = (struct IOStdReq*)_CreateExtIO(dev, port, sizeof(struct IOStdReq)))) break;
+        // Opening is where an empty ID costs its selection timeout
+        if (OpenDevice(openData->deviceDriverName, id & 7, (struct IORequest*)probe->SCSIReq, 0)) {
+            _DeleteExtIO(dev, (struct IORequest*)probe->SCSIReq);
+            probe->SCSIReq = NULL;
+        } else {
+            probe->scsiCommand[0] = SCSI_INQUIRY;
+            probe->scsiCommand[4] = INQUIRE_BUFFER_SIZE;
+            probe->Cmd.scsi_Data = (UWORD*)probe->inquiry;
+            probe->Cmd.scsi_Length = INQUIRE_BUFFER_SIZE;
+            probe->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
+            probe->Cmd.scsi_CmdLength = 6;
+            probe->Cmd.scsi_Command = probe->scsiCommand;
+            probe->Cmd.scsi_SenseData = (UBYTE*)&probe->senseData;
+            probe->Cmd.scsi_SenseLength = 20;
+            probe->Cmd.scsi_Status = 1;
+            probe->SCSIReq->io_Length = sizeof(struct SCSICmd);
+            probe->SCSIReq->io_Data = (APTR)&probe->Cmd;
+            probe->SCSIReq->io_Command = HD_SCSICMD;
+            SendIO((struct IORequest*)probe->SCSIReq);
+            probe->busy = 1;
+        }
+        // A working target answers well within the grace period.  One that doesn't is left to
+        // carry on while the next ID is opened, rather than holding up the search
+        found = _SCSIWifi_waitProbes(dev, probes, timer, SCSIWIFI_PROBE_GRACE, signature);
+    }
+    // Those still going get the rest of the timeout
+    if (found < 0) found = _SCSIWifi_waitProbes(dev, probes, timer, SCSIWIFI_PROBE_TIMEOUT * 1000000UL, signature);
+
+    if (timer) {
+        CloseDevice((struct IORequest*)timer);
+        _DeleteExtIO(dev, (struct IORequest*)timer);
+    }
+    // Anything still going has had its chance
+    for (USHORT i=0; i<8; i++) {
+        if (!probes[i].SCSIReq) continue;
+        if (probes[i].busy) {
+            if (!CheckIO((struct IORequest*)probes[i].SCSIReq)) AbortIO((struct IORequest*)probes[i].SCSIReq);
+            WaitIO((struct IORequest*)probes[i].SCSIReq);
+        }
+        CloseDevice((struct IORequest*)probes[i].SCSIReq);
+        _DeleteExtIO(dev, (struct IORequest*)probes[i].SCSIReq);
+    }
+    FreeVec(probes);
+    _DeletePort(dev, port);
+    return found;
+}
+
+LONG SCSIWifi_loadDetected(void *utilityBase, void* dosBase, char* deviceName, char* signature, USHORT* scsiMode) {
+    struct SCSIDevice devTmp;
+    LSCSIDevice dev = &devTmp;
+    devTmp.sc_dosBase = dosBase;
+    devTmp.sc_UtilityBase = utilityBase;
+
+    LONG deviceID = -1;
+    USHORT sameDevice = 0;
+    BPTR fh;
+    signature[0] = '\0';
+    *scsiMode = SCSIWIFI_MODE_AUTO;
+    if (fh = Open("ENV:scsidayna.detected",MODE_OLDFILE)) {
+        char buffer[128];
+        while (FGets(fh, buffer, 128)) {
+            char* value;
+            removeNL(buffer);
+            if (!tokeniseSetting(buffer, &value)) continue;
+            if (Stricmp(buffer, "DEVICE") == 0) sameDevice = Stricmp(value, deviceName) == 0; else
+            if (Stricmp(buffer, "DEVICEID") == 0) deviceID = _atos(value); else
+            if (Stricmp(buffer, "MODE") == 0) *scsiMode = (_atous(value) < SCSIWIFI_MODE_COUNT) ? _atous(value) : SCSIWIFI_MODE_AUTO; else
+            if (Stricmp(buffer, "INQUIRY") == 0) {
+                USHORT length = strlen(value);
+                if (length > SCSIWIFI_SIGNATURE_SIZE) length = SCSIWIFI_SIGNATURE_SIZE;
+                memcpy(signature, value, length);
+                signature[length] = '\0';
+            }
+        }
+        Close(fh);
+    }
+    // It's only any use for the same SCSI driver
+    if ((!sameDevice) || (deviceID < 0) || (deviceID > 7)) {
+        signature[0] = '\0';
+        *scsiMode = SCSIWIFI_MODE_AUTO;
+        return -1;
+    }
+    return deviceID;
+}
+
+LONG SCSIWifi_saveDetected(struct DosBase *dosBase, char* deviceName, LONG deviceID, char* signature, USHORT scsiMode) {
+    struct SCSIDevice devTmp;
+    LSCSIDevice dev = &devTmp;
+    devTmp.sc_dosBase = dosBase;
+    USHORT good = 1;
+    char tmp[20], mode[20];
+    _stoa(deviceID, tmp);
+    if (scsiMode < SCSIWIFI_MODE_COUNT) _ustoa(scsiMode, mode); else mode[0] = '\0';
+
+    // ENV: for now, ENVARC: so it's still there after a reboot
+    for (USHORT archive = 0; archive < 2; archive++) {
+        BPTR fh;
+        if (fh = Open(archive ? "ENVARC:scsidayna.detected" : "ENV:scsidayna.detected", MODE_NEWFILE)) {
+            if ((FPuts(fh, "DEVICE=")) || (FPuts(fh, deviceName)) || (FPuts(fh, "\nDEVICEID=")) || (FPuts(fh, tmp)) ||
+                (FPuts(fh, "\nINQUIRY=")) || (FPuts(fh, signature)) || (FPuts(fh, "\n"))) good = 0;
+            if ((mode[0]) && ((FPuts(fh, "MODE=")) || (FPuts(fh, mode)) || (FPuts(fh, "\n")))) good = 0;
+            Close(fh);
+        } else good = 0;
+    }
+    return good;
+}
+
 // Close and free the open SCSI device
 void SCSIWifi_close(SCSIWIFIDevice device) {
     if (!device) return;
@@ -460,11 +861,11 @@ LONG SCSIWifi_scan(SCSIWIFIDevice device, enum SCSIWifi_ScanStatus* status) {
 
     SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_CMD, SCSI_NETWORK_WIFI_OPT_SCAN, 0, 0, 0, 0);    
 
-    dev->Cmd.scsi_Data = (APTR)&dev->scsiCommand;
+    dev->Cmd.scsi_Data = (APTR)&dev->scsiCommand[6];
     dev->Cmd.scsi_Length = 4;                       // NEEDS to be 4
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
     // Failed
     if (dev->Cmd.scsi_Status) return 0;
@@ -492,7 +893,7 @@ LONG SCSIWifi_scanComplete(SCSIWIFIDevice device, enum SCSIWifi_ScanStatus* stat
     dev->Cmd.scsi_Length = 4;                       // NEEDS to be 4
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
     // Failed
     if (dev->Cmd.scsi_Status) return 0;
@@ -520,7 +921,7 @@ LONG SCSIWifi_getScanResults(SCSIWIFIDevice device, struct SCSIWifi_ScanResults*
     dev->Cmd.scsi_Length = sizeof(struct SCSIWifi_ScanResults);       
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
     // Failed
     if (dev->Cmd.scsi_Status) return 0;
@@ -547,7 +948,7 @@ LONG SCSIWifi_enable(SCSIWIFIDevice device, LONG setEnable) {
     dev->Cmd.scsi_Length = 0;
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq ); 
+    _SCSIWifi_doIO(dev);
 
     if (dev->Cmd.scsi_Status) return 0;
 
@@ -565,7 +966,7 @@ LONG SCSIWifi_getMACAddress(SCSIWIFIDevice device, struct SCSIWifi_MACAddress* m
     dev->Cmd.scsi_Length = 6;
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
     if (dev->Cmd.scsi_Status) return 0;
 
@@ -590,7 +991,7 @@ LONG SCSIWifi_joinNetwork(SCSIWIFIDevice device, struct SCSIWifi_JoinRequest* wi
     dev->Cmd.scsi_Length = sizeof(struct SCSIWifi_JoinRequest);         
     dev->Cmd.scsi_Flags = SCSIF_WRITE | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
     if (dev->Cmd.scsi_Status) return 0;
     
@@ -604,19 +1005,15 @@ LONG SCSIWifi_getNetwork(SCSIWIFIDevice device, struct SCSIWifi_NetworkEntry* co
 
     SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_CMD, SCSI_NETWORK_WIFI_OPT_INFO, 0, 0, 0, 0);
 
-    UBYTE* netBuffer = AllocVec(sizeof(struct SCSIWifi_NetworkEntry) + 2,MEMF_PUBLIC|MEMF_CLEAR);
-    if (!netBuffer) return 0;
+    UBYTE* netBuffer = dev->scratch.network;
 
     dev->Cmd.scsi_Data = (APTR)netBuffer;       
-    dev->Cmd.scsi_Length = sizeof(struct SCSIWifi_NetworkEntry) + 2;   
+    dev->Cmd.scsi_Length = sizeof(dev->scratch.network);   
     dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );   
+    _SCSIWifi_doIO(dev);
 
-    if (dev->Cmd.scsi_Status) {
-        FreeVec(netBuffer);
-        return 0;
-    }
+    if (dev->Cmd.scsi_Status) return 0;
 
     // Check the result
     if (dev->Cmd.scsi_Actual > 2) {
@@ -624,12 +1021,10 @@ LONG SCSIWifi_getNetwork(SCSIWIFIDevice device, struct SCSIWifi_NetworkEntry* co
         if (size > sizeof(struct SCSIWifi_NetworkEntry)) size = sizeof(struct SCSIWifi_NetworkEntry);
         if (size > dev->Cmd.scsi_Actual-2) size = dev->Cmd.scsi_Actual - 2;
         memcpy(connection, &netBuffer[2], size);
-        FreeVec(netBuffer);
 
         return (size == sizeof(struct SCSIWifi_NetworkEntry)) ? 1 : 0;
     }
 
-    FreeVec(netBuffer);
     return 0;
 }
 
@@ -644,7 +1039,7 @@ LONG SCSIWifi_addMulticastAddress(SCSIWIFIDevice device, struct SCSIWifi_MACAddr
     dev->Cmd.scsi_Length = 6;
     dev->Cmd.scsi_Flags = SCSIF_WRITE | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );  
+    _SCSIWifi_doIO(dev);
 
     LONG ret = 1;
     if (dev->Cmd.scsi_Status) ret = 0;    
@@ -661,7 +1056,7 @@ LONG SCSIWifi_sendFrame(SCSIWIFIDevice device, UBYTE* packet, UWORD packetSize)
     dev->Cmd.scsi_Length = packetSize;
     dev->Cmd.scsi_Flags = SCSIF_WRITE | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq );     
+    _SCSIWifi_doIO(dev);
 
     if (dev->Cmd.scsi_Status) return 0;
     return 1;
@@ -669,6 +1064,46 @@ LONG SCSIWifi_sendFrame(SCSIWIFIDevice device, UBYTE* packet, UWORD packetSize)
 
 
 
+// Fills in the READ for the current mode from the command _SCSIWifi_setReadCommand built.  control is the CDB
+// control byte.  xfer is anything with scsiCommand and Cmd
+#define SCSI_PREPREAD(dev, xfer, packetBuffer, size, control) \
+    SCSI_PREPCMD(xfer, dev->readCommand[0], dev->readCommand[1], dev->readCommand[2], (size) >> 8, (size) & 0xFF, control); \
+    xfer->Cmd.scsi_Data = (APTR)(packetBuffer); \
+    xfer->Cmd.scsi_Length = (size); \
+    xfer->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
+
+// Issues the READ for the current mode.  control is the CDB control byte
+LONG _SCSIWifi_read(LSCSIDevice dev, UBYTE* packetBuffer, UWORD* packetSize, UBYTE control) {
+    SCSI_PREPREAD(dev, dev, packetBuffer, *packetSize, control);
+
+    _SCSIWifi_doIO(dev);
+
+    if ((dev->Cmd.scsi_Status) || (dev->Cmd.scsi_Actual < 6)) return 0;
+
+    *packetSize = dev->Cmd.scsi_Actual;
+
+    return 1;
+}
+
+LONG SCSIWifi_canBatchWrites(SCSIWIFIDevice device) {
+    return ((LSCSIDevice)device)->batchConfirmed;
+}
+
+// Send several frames in one WRITE FRAME - see scsiwifi.h for the layout
+LONG SCSIWifi_sendFrames(SCSIWIFIDevice device, UBYTE* packets, UWORD totalSize) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+
+    SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_WRITEFRAME, 0, 0, totalSize >> 8, totalSize & 0xFF, SCSI_NETWORK_WIFI_WRITE_HEADER | SCSI_NETWORK_WIFI_WRITE_BATCHED);
+    dev->Cmd.scsi_Data = (APTR)packets;
+    dev->Cmd.scsi_Length = totalSize;
+    dev->Cmd.scsi_Flags = SCSIF_WRITE | SCSIF_AUTOSENSE;
+
+    _SCSIWifi_doIO(dev);
+
+    if (dev->Cmd.scsi_Status) return 0;
+    return 1;
+}
+
 // On ENTRY, packetSize should be the memory size of packetBuffer, which SHOULD be NETWORK_PACKET_MAX_SIZE + 6
 // If returns TRUE and packetSize=0 then no data is waiting to be read
 // Else packetSize will be what was read with the first 6 bytes being in the following format:
@@ -680,30 +1115,226 @@ LONG SCSIWifi_sendFrame(SCSIWIFIDevice device, UBYTE* packet, UWORD packetSize)
 //           5: 0 if this was the last packet, or 0x10 if there are more to read
 //      last 4 bytes are the CRC for the packet which we dont care about!
 LONG SCSIWifi_receiveFrame(SCSIWIFIDevice device, UBYTE* packetBuffer, UWORD* packetSize) {
-    LSCSIDevice dev = (LSCSIDevice)device;
+    return _SCSIWifi_read((LSCSIDevice)device, packetBuffer, packetSize, 0);
+}
 
-   switch (dev->scsiMode) {
-       case 1:  // scsi.device mode
-            SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_CMD, SCSI_NETWORK_WIFI_OPT_ALTREAD,  0xA8, (*packetSize) >> 8, (*packetSize) & 0xFF, 0);
-            break;
+// Looks at what came back from a batched read and decides whether the firmware really supports them
+void _SCSIWifi_checkBatch(LSCSIDevice dev, UBYTE* packetBuffer, UWORD allocation) {
+    // Older firmware ignores the flag. If it said more were waiting but sent only one when there 
+    // was room for another, stop asking, as mode 2 pays for the whole allocation every time
+    if ((packetBuffer[5] & SCSIWIFI_FLAG_MORE_FRAMES) && (!(packetBuffer[5] & SCSIWIFI_FLAG_RECORD_FOLLOWS)) &&
+        (allocation >= (SCSIWIFI_PACKET_MAX_SIZE + 6) * 2)) {
+        D(("scsidayna: batched reads not supported by the firmware\n"));
+        dev->batchReads = 0;
+    }
+    if (packetBuffer[5] & SCSIWIFI_FLAG_RECORD_FOLLOWS) dev->batchConfirmed = 1;
+}
 
-        case 2:  // gvpscsi.device mode
-            SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_CMD, SCSI_NETWORK_WIFI_OPT_ALTREAD,  0xA9, (*packetSize) >> 8, (*packetSize) & 0xFF, 0);
-            break;
+// Asks for as many frames as will fit in packetBuffer, see scsiwifi.h for the layout
+LONG SCSIWifi_receiveFrames(SCSIWIFIDevice device, UBYTE* packetBuffer, UWORD* packetSize) {
+    LSCSIDevice dev = (LSCSIDevice)device;
 
-        default:
-            SCSI_PREPCMD(dev, SCSI_NETWORK_WIFI_READFRAME, 0, 0, (*packetSize) >> 8, (*packetSize) & 0xFF, 0);
-            break;
+    if (dev->batchReads) {
+        // Rounded down, it's the caller's buffer
+        UWORD allocation = ((*packetSize > dev->batchAllocation) ? dev->batchAllocation : *packetSize) & ~(dev->transport->lengthRound - 1);
+        UWORD size = allocation;
+        if (_SCSIWifi_read(dev, packetBuffer, &size, SCSI_NETWORK_WIFI_READ_BATCHED)) {
+            _SCSIWifi_checkBatch(dev, packetBuffer, allocation);
+            *packetSize = size;
+            return 1;
+        }
+        // A CHECK CONDITION means it didn't like the control byte. Anything else is a real failure
+        if (dev->Cmd.scsi_Status != 2) return 0;
+        D(("scsidayna: batched reads not supported by the firmware\n"));
+        dev->batchReads = 0;
     }
-    dev->Cmd.scsi_Data = (APTR)packetBuffer;
-    dev->Cmd.scsi_Length = *packetSize;
-    dev->Cmd.scsi_Flags = SCSIF_READ | SCSIF_AUTOSENSE;
 
-    DoIO( (struct IORequest*)dev->SCSIReq ); 
+    // Only ask for one frame, as mode 2 transfers the whole allocation
+    if (*packetSize > SCSIWIFI_PACKET_MAX_SIZE + 6) *packetSize = SCSIWIFI_PACKET_MAX_SIZE + 6;
+    return _SCSIWifi_read(dev, packetBuffer, packetSize, 0);
+}
 
-    if ((dev->Cmd.scsi_Status) || (dev->Cmd.scsi_Actual < 6)) return 0;
+// Starts a read into the next free transfer buffer without waiting for it
+LONG SCSIWifi_startReceive(SCSIWIFIDevice device) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    struct SCSITransfer* t = &dev->transfers[dev->nextStart];
+    if (t->busy) return 0;
 
-    *packetSize = dev->Cmd.scsi_Actual;
+    t->batched = dev->batchReads ? 1 : 0;
+    t->allocation = t->batched ? dev->batchAllocation : dev->singleAllocation;
+    SCSI_PREPREAD(dev, t, t->buffer, t->allocation, t->batched ? SCSI_NETWORK_WIFI_READ_BATCHED : 0);
 
+    if (dev->commandTimes) {
+        struct EClockVal now;
+        ReadEClock(&now);
+        t->started = now.ev_lo;
+    }
+    TRACE(dev->trace, teScsiSubmit, 0x10000 | ((ULONG)t->scsiCommand[0] << 8) | t->scsiCommand[1], t->SCSIReq);
+    SendIO( (struct IORequest*)t->SCSIReq );
+    t->busy = 1;
+    if (++dev->nextStart == SCSIWIFI_ASYNC_TRANSFERS) dev->nextStart = 0;
     return 1;
 }
+
+// Returns the number of reads started and not yet collected
+LONG SCSIWifi_receivesPending(SCSIWIFIDevice device) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    LONG count = 0;
+    for (USHORT i=0; i<SCSIWIFI_ASYNC_TRANSFERS; i++)
+        if (dev->transfers[i].busy) count++;
+    return count;
+}
+
+// Waits for the oldest read started with SCSIWifi_startReceive
+LONG SCSIWifi_collectReceive(SCSIWIFIDevice device, UBYTE** packetBuffer, UWORD* packetSize) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    struct SCSITransfer* t = &dev->transfers[dev->nextCollect];
+    if (!t->busy) return 0;
+
+    WaitIO( (struct IORequest*)t->SCSIReq );
+    TRACE(dev->trace, teScsiComplete, t->Cmd.scsi_Status ? 0xFFFFFFFF : t->Cmd.scsi_Actual, t->SCSIReq);
+    *packetBuffer = t->buffer;
+    if (dev->commandTimes) {
+        struct EClockVal now;
+        ReadEClock(&now);
+        SCSIWifi_addTime(&dev->commandTimes->commands[swccRead], now.ev_lo - t->started);
+    }
+
+    if ((!t->Cmd.scsi_Status) && (t->Cmd.scsi_Actual >= 6)) {
+        if (t->batched) _SCSIWifi_checkBatch(dev, t->buffer, t->allocation);
+        *packetSize = t->Cmd.scsi_Actual;
+        return 1;
+    }
+
+    // A CHECK CONDITION on a batched read means it didn't like the control byte.  Ask again for just one
+    if ((t->batched) && (t->Cmd.scsi_Status == 2)) {
+        D(("scsidayna: batched reads not supported by the firmware\n"));
+        dev->batchReads = 0;
+        *packetSize = dev->singleAllocation;
+        return _SCSIWifi_read(dev, t->buffer, packetSize, 0);
+    }
+    return 0;
+}
+
+// Hands the buffer from SCSIWifi_collectReceive back
+void SCSIWifi_releaseReceive(SCSIWIFIDevice device) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    dev->transfers[dev->nextCollect].busy = 0;
+    if (++dev->nextCollect == SCSIWIFI_ASYNC_TRANSFERS) dev->nextCollect = 0;
+}
+
+// Waits for anything still in flight and throws it away
+void SCSIWifi_cancelReceives(SCSIWIFIDevice device) {
+    UBYTE* buffer;
+    UWORD size;
+    while (SCSIWifi_receivesPending(device)) {
+        SCSIWifi_collectReceive(device, &buffer, &size);
+        SCSIWifi_releaseReceive(device);
+    }
+}
+
+void SCSIWifi_setMode(SCSIWIFIDevice device, USHORT scsiMode) {
+    _SCSIWifi_setReadCommand((LSCSIDevice)device, scsiMode);
+}
+
+struct SCSIWifi_Transport* SCSIWifi_getTransport(SCSIWIFIDevice device) {
+    return ((LSCSIDevice)device)->transport;
+}
+
+// Sends one calibration READ on the first transfer, returning the EClock ticks it took, or 0 if it went wrong.
+// If it's aborted and still doesn't come back the device is marked wedged rather than waiting on it forever
+ULONG _SCSIWifi_calibrateRead(LSCSIDevice dev) {
+    struct SCSITransfer* t = &dev->transfers[0];
+    struct timerequest* timer = &dev->calibrateTimer;
+    struct EClockVal start, end;
+    UWORD allocation = dev->singleAllocation;
+
+    SCSI_PREPREAD(dev, t, t->buffer, allocation, 0);
+    memset(t->buffer, 0xFF, 6);
+    timer->tr_node.io_Command = TR_ADDREQUEST;
+    timer->tr_time.tv_secs = SCSIWIFI_CALIBRATE_TIMEOUT;
+    timer->tr_time.tv_micro = 0;
+
+    ReadEClock(&start);
+    SendIO((struct IORequest*)t->SCSIReq);
+    SendIO((struct IORequest*)timer);
+    while ((!CheckIO((struct IORequest*)t->SCSIReq)) && (!CheckIO((struct IORequest*)timer)))
+        Wait(1L << dev->Port->mp_SigBit);
+    ReadEClock(&end);
+
+    // Some drivers hang on the wrong variant rather than failing it, and some of those don't honour AbortIO either
+    USHORT hung = CheckIO((struct IORequest*)t->SCSIReq) ? 0 : 1;
+    if (hung) {
+        WaitIO((struct IORequest*)timer);
+        AbortIO((struct IORequest*)t->SCSIReq);
+        timer->tr_node.io_Command = TR_ADDREQUEST;
+        timer->tr_time.tv_secs = SCSIWIFI_CALIBRATE_TIMEOUT;
+        timer->tr_time.tv_micro = 0;
+        SendIO((struct IORequest*)timer);
+        while ((!CheckIO((struct IORequest*)t->SCSIReq)) && (!CheckIO((struct IORequest*)timer)))
+            Wait(1L << dev->Port->mp_SigBit);
+    }
+    if (!CheckIO((struct IORequest*)timer)) AbortIO((struct IORequest*)timer);
+    WaitIO((struct IORequest*)timer);
+    if (!CheckIO((struct IORequest*)t->SCSIReq)) {
+        t->busy = 1;
+        dev->wedged = 1;
+        return 0;
+    }
+    WaitIO((struct IORequest*)t->SCSIReq);
+
+    // With nothing waiting the header has to say so
+    if ((hung) || (t->SCSIReq->io_Error) || (t->Cmd.scsi_Status) || (t->Cmd.scsi_Actual < 6) ||
+        (t->Cmd.scsi_Actual > allocation) || (t->buffer[0]) || (t->buffer[1])) return 0;
+    return (end.ev_lo - start.ev_lo) | 1;
+}
+
+LONG SCSIWifi_calibrate(SCSIWIFIDevice device, ULONG* readTicks) {
+    LSCSIDevice dev = (LSCSIDevice)device;
+    struct timerequest* timer = &dev->calibrateTimer;
+    struct Library* timedBase = dev->sc_TimerBase;
+    LONG best = -1;
+
+    for (USHORT mode=0; mode<SCSIWIFI_MODE_COUNT; mode++) readTicks[mode] = 0;
+    if (dev->transfers[0].busy) return -1;
+
+    memset(timer, 0, sizeof(struct timerequest));
+    timer->tr_node.io_Message.mn_ReplyPort = dev->Port;
+    timer->tr_node.io_Message.mn_Length = sizeof(struct timerequest);
+    timer->tr_node.io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+    if (OpenDevice(TIMERNAME, UNIT_VBLANK, (struct IORequest*)timer, 0)) return -1;
+    TimerBase = (struct Library*)timer->tr_node.io_Device;
+
+    // Disabled, nothing can arrive
+    if (SCSIWifi_enable(device, 0)) {
+        USHORT oldMode = dev->scsiMode;
+        for (USHORT mode=0; (mode<SCSIWIFI_MODE_COUNT) && (!dev->wedged); mode++) {
+            ULONG total = 0;
+            if (dev->transport->unsafeModes & SCSIWIFI_MODEF(mode)) {
+                D(("scsidayna: MODE=%ld is known to hang %s, not trying it\n", (LONG)mode, dev->transport->driverName));
+                continue;
+            }
+            _SCSIWifi_setReadCommand(dev, mode);
+            for (USHORT i=0; i<SCSIWIFI_CALIBRATE_READS; i++) {
+                ULONG ticks = _SCSIWifi_calibrateRead(dev);
+                if (dev->wedged) {
+                    D(("scsidayna: MODE=%ld hung the controller, even when aborted\n", (LONG)mode));
+                    break;
+                }
+                if (!ticks) {
+                    D(("scsidayna: MODE=%ld doesn't work with this controller\n", (LONG)mode));
+                    total = 0;
+                    break;
+                }
+                total += ticks;
+            }
+            readTicks[mode] = total;
+            if ((total) && ((best < 0) || (total < readTicks[best]))) best = mode;
+        }
+        _SCSIWifi_setReadCommand(dev, (best >= 0) ? best : oldMode);
+    }
+
+    TimerBase = timedBase;
+    CloseDevice((struct IORequest*)timer);
+    return (dev->wedged) ? SCSIWIFI_CALIBRATE_WEDGED : best;
+}
@@ -23,6 +23,67 @@
 #define SCSIWIFI_PACKET_MAX_SIZE     1520
 #define SCSIWIFI_PACKET_MTU_SIZE     1500
 
+// Big enough for several full sized frames when the firmware packs them into one READ
+#define SCSIWIFI_RECEIVE_BUFFER_SIZE 8192
+
+// Flags in byte 5 of a received frame header
+#define SCSIWIFI_FLAG_MORE_FRAMES    0x10   // the DaynaPORT has more frames waiting
+#define SCSIWIFI_FLAG_RECORD_FOLLOWS 0x40   // batched reads: another frame follows this one in the buffer
+
+// Batching is an extension the shipping BlueSCSI and ZuluSCSI firmware doesn't have: a READ or WRITE FRAME with
+// the vendor bit 0x40 set in its control byte carries several frames.  It's only asked for with BATCH=1, otherwise
+// every READ is for one frame, with the single frame allocation
+
+// Polling for incoming frames: the fastest and (default) slowest rate, in microseconds between polls.
+// POLLMAX=0 uses the slowest rate in the SCSI driver's SCSIWifi_Transport
+#define SCSIWIFI_POLL_MIN            1000
+#define SCSIWIFI_POLL_MAX_DEFAULT    0     // milliseconds, as in the POLLMAX setting
+#define SCSIWIFI_POLL_MAX_LIMIT      999   // milliseconds, the timer wants under a second
+#define SCSIWIFI_RX_POOL_DEFAULT     16    // frames, as in the RXPOOL setting
+#define SCSIWIFI_RX_POOL_LIMIT       64
+#define SCSIWIFI_LINGER_DEFAULT      10    // seconds, as in the LINGER setting
+#define SCSIWIFI_LINGER_LIMIT        3600
+
+// Auto-detect: how long (seconds) the INQUIRYs sent to every ID get to answer, and the size of the
+// INQUIRY signature (vendor, product and revision) kept with the detected ID
+#define SCSIWIFI_PROBE_TIMEOUT       2
+#define SCSIWIFI_PROBE_GRACE         100000    // microseconds an INQUIRY has before the next ID is opened anyway
+#define SCSIWIFI_SIGNATURE_SIZE      28
+
+// MODE=-1: the READ variant is worked out by SCSIWifi_calibrate the first time the DaynaPORT is used with a
+// driver, and remembered with the detected ID.  Each mode gets SCSIWIFI_CALIBRATE_READS reads, none allowed
+// longer than SCSIWIFI_CALIBRATE_TIMEOUT seconds.  A read that's still out that long after being aborted has
+// wedged the driver, and SCSIWifi_calibrate gives up with SCSIWIFI_CALIBRATE_WEDGED
+#define SCSIWIFI_MODE_AUTO           0xFFFF
+#define SCSIWIFI_MODE_COUNT          3
+#define SCSIWIFI_MODEF(mode)         (1 << (mode))
+#define SCSIWIFI_CALIBRATE_WEDGED    -2
+#define SCSIWIFI_CALIBRATE_READS     8
+#define SCSIWIFI_CALIBRATE_TIMEOUT   1
+
+// Reads that can be in flight at once, each with its own SCSIWIFI_RECEIVE_BUFFER_SIZE buffer
+#define SCSIWIFI_ASYNC_TRANSFERS     2
+
+// Batched writes: up to this many frames, each with a 4 byte header, in one WRITE FRAME
+#define SCSIWIFI_SEND_HEADER_SIZE    4
+#define SCSIWIFI_TX_BATCH_MAX        8
+
+// Latency histograms, in EClock ticks.  Bucket n counts times under 2^(n+SCSIWIFI_HISTOGRAM_SHIFT) ticks, 
+// the last bucket everything longer
+#define SCSIWIFI_HISTOGRAM_BUCKETS   16
+#define SCSIWIFI_HISTOGRAM_SHIFT     6
+
+struct SCSIWifi_Histogram {
+    ULONG buckets[SCSIWIFI_HISTOGRAM_BUCKETS];
+};
+
+// SCSI commands are timed by what they do
+enum SCSIWifi_CommandClass {swccRead, swccWrite, swccOther, swccCount};
+
+struct SCSIWifi_CommandTimes {
+    struct SCSIWifi_Histogram commands[swccCount];
+};
+
 // Result from calling SCSIWifi_open
 enum SCSIWifi_OpenResult {sworOK, sworOpenDeviceFailed, sworOutOfMem, sworInquireFail, sworNotDaynaDevice};
 
@@ -77,6 +138,16 @@ struct ScsiDaynaSettings {
   USHORT autoConnect;
   char ssid[64];
   char key[64];
+  // How long (microseconds) small frames may be held so they can be sent together, 0 = off
+  USHORT txWindow;
+  // Longest time (milliseconds) between polls for incoming frames when the link is idle, 0 = what suits the SCSI driver
+  USHORT pollMax;
+  // Frames that can be kept for CMD_READs that haven't been queued yet, 0 = none
+  USHORT rxPool;
+  // Seconds the SCSI side stays up after the last close, so reopening is quick, 0 = stop straight away
+  USHORT linger;
+  // 1 = the firmware packs several frames into a READ and takes several per WRITE FRAME (see SCSIWIFI_FLAG_RECORD_FOLLOWS), 0 = one at a time
+  USHORT batch;
 };
 
 #ifdef __VBCC__
@@ -94,6 +165,19 @@ struct STRUCT_ALIGN16 SCSIWifi_ScanResults {
 #endif
 
 
+// How a SCSI driver (and so its controller) likes to be driven.  SCSIWifi_open picks the entry for the driver
+// it's given and sticks with it, so a new controller's quirks are a new line in the table in scsiwifi.c
+struct SCSIWifi_Transport {
+    char* driverName;      // matched without the path or case.  NULL for the last entry, used for anything else
+    USHORT scsiMode;       // READ variant it needs, or SCSIWIFI_MODE_AUTO if only SCSIWifi_calibrate can tell
+    USHORT lengthRound;    // READ allocations are a multiple of this many bytes (a power of 2)
+    USHORT maxTransfer;    // largest READ allocation, at most SCSIWIFI_RECEIVE_BUFFER_SIZE
+    USHORT alignment;      // transfer buffers start on a multiple of this many bytes (a power of 2)
+    ULONG memoryType;      // MEMF_ flags for memory it transfers to and from
+    USHORT pollMax;        // milliseconds, the slowest poll rate when POLLMAX=0
+    USHORT unsafeModes;    // SCSIWIFI_MODEF bits for READ variants known to hang it, which calibration never tries
+};
+
 // Device handle - yeah you don't need to know what's inside
 typedef void* SCSIWIFIDevice;
 
@@ -105,6 +189,7 @@ struct SCSIDevice_OpenData {
 
     SHORT deviceID;                     // SCSI ID (0-7)
     USHORT scsiMode;                  // Special mode, from settings
+    USHORT batch;                     // try batched READs, from settings
 
     char* deviceDriverName;             // SCSI Driver to use (eg: scsi.device or gvpscsi.device etc)
 };
@@ -118,12 +203,64 @@ LONG SCSIWifi_loadSettings(void *utilityBase, void *dosBase, struct ScsiDaynaSet
 // Saves settings back to ENV or ENVARC - returns 0 if it failed
 LONG SCSIWifi_saveSettings(struct DosBase *dosBase, struct ScsiDaynaSettings* settings, LONG saveToENV);
 
+// The table entry for a SCSI driver
+struct SCSIWifi_Transport* SCSIWifi_findTransport(void *utilityBase, char* deviceName);
+
+// The likeliest MODE for a SCSI driver, for when it can't be calibrated
+USHORT SCSIWifi_guessMode(void *utilityBase, char* deviceName);
+
 // Attempt to open the DAYNA scsi device. 
 SCSIWIFIDevice SCSIWifi_open(struct SCSIDevice_OpenData* openData, enum SCSIWifi_OpenResult* errorCode);
 
+// Looks for the DaynaPORT on every ID of openData->deviceDriverName but skipID, starting at 4.  Each ID that opens
+// is sent an INQUIRY.  One that hasn't answered within SCSIWIFI_PROBE_GRACE carries on while the next ID is opened,
+// and all of them get SCSIWIFI_PROBE_TIMEOUT at the end.  Returns the first ID found and its signature (SCSIWIFI_SIGNATURE_SIZE+1 bytes), or -1
+LONG SCSIWifi_findDevice(struct SCSIDevice_OpenData* openData, LONG skipID, char* signature);
+
+// The device's replies signal the task that opened it, or last adopted it.  That task must release it before
+// another adopts it, and if it's closed by a task that hasn't adopted it, it must be released first.
+// Adopt returns 0 if there's no signal free
+LONG SCSIWifi_adopt(SCSIWIFIDevice device);
+void SCSIWifi_release(SCSIWIFIDevice device);
+
+// The INQUIRY signature of an open device (SCSIWIFI_SIGNATURE_SIZE+1 bytes)
+void SCSIWifi_getSignature(SCSIWIFIDevice device, char* signature);
+
+// The table entry SCSIWifi_open chose for the device
+struct SCSIWifi_Transport* SCSIWifi_getTransport(SCSIWIFIDevice device);
+
+// Loads the ID auto-detect found last time on deviceName, its signature and the mode calibrated for it
+// (SCSIWIFI_MODE_AUTO if it wasn't).  Returns -1 if there isn't one
+LONG SCSIWifi_loadDetected(void *utilityBase, void *dosBase, char* deviceName, char* signature, USHORT* scsiMode);
+
+// Saves what auto-detect and calibration found to ENV and ENVARC, so the next boot tries it first - returns 0 if it failed.
+// scsiMode can be SCSIWIFI_MODE_AUTO if it's not known
+LONG SCSIWifi_saveDetected(struct DosBase *dosBase, char* deviceName, LONG deviceID, char* signature, USHORT scsiMode);
+
+// Tries every READ variant with the DaynaPORT disabled, where the only right answer is "nothing waiting", timing
+// each.  The device is left disabled and in the quickest mode that always got it right, which is returned, or -1
+// if none did.  readTicks (SCSIWIFI_MODE_COUNT) gets each mode's EClock ticks for its reads, 0 if it failed or the
+// transport marks it unsafe.  SCSIWIFI_CALIBRATE_WEDGED means a read never came back even after AbortIO: the
+// driver still has it, so the device can only be closed (which then leaves it what it's holding)
+LONG SCSIWifi_calibrate(SCSIWIFIDevice device, ULONG* readTicks);
+
+// Changes the READ variant in use
+void SCSIWifi_setMode(SCSIWIFIDevice device, USHORT scsiMode);
+
 // Free and release any memory allocated as a result of SCSIWifi_open. 
 void SCSIWifi_close(SCSIWIFIDevice device);
 
+// Times every command from now on into times, using timer.device's ReadEClock.  Reads started with 
+// SCSIWifi_startReceive are timed from when they're sent to when they're collected
+void SCSIWifi_setTiming(SCSIWIFIDevice device, struct Library* timerBase, struct SCSIWifi_CommandTimes* times);
+
+// Records each command's start and end in trace (see trace.h), NULL to stop
+struct TraceRing;
+void SCSIWifi_setTrace(SCSIWIFIDevice device, struct TraceRing* trace);
+
+// Counts ticks in the right bucket of histogram
+void SCSIWifi_addTime(struct SCSIWifi_Histogram* histogram, ULONG ticks);
+
 // Triggers a WIFI scan.  Returns 1 if successful
 LONG SCSIWifi_scan(SCSIWIFIDevice device, enum SCSIWifi_ScanStatus* status);
 
@@ -151,6 +288,18 @@ LONG SCSIWifi_addMulticastAddress(SCSIWIFIDevice device, struct SCSIWifi_MACAddr
 // Send an ethernet frame (this is actually queued and sent inside the bluescsi/scsi2sd)
 LONG SCSIWifi_sendFrame(SCSIWIFIDevice device, UBYTE* packet, UWORD packetSize);
 
+// Returns 1 once the firmware has shown it understands batched transfers (by batching a READ)
+LONG SCSIWifi_canBatchWrites(SCSIWIFIDevice device);
+
+// Send several ethernet frames in one command.  Each frame in packets is preceded by a 4 byte header:
+//   Byte:   0 High Byte of frame size
+//           1: Low Byte of frame size
+//           2: SCSIWIFI_FLAG_RECORD_FOLLOWS if another frame follows this one
+//           3: 0
+// and is padded to an even size so the next header is word aligned.  totalSize covers everything.
+// Only use this if SCSIWifi_canBatchWrites returns 1
+LONG SCSIWifi_sendFrames(SCSIWIFIDevice device, UBYTE* packets, UWORD totalSize);
+
 // On ENTRY, packetSize should be the memory size of packetBuffer, which SHOULD be SCSIWIFI_PACKET_MAX_SIZE + 6
 // If returns TRUE and packetSize=0 then no data is waiting to be read
 // Else packetSize will be what was read with the first 6 bytes being in the following format:
@@ -161,5 +310,26 @@ LONG SCSIWifi_sendFrame(SCSIWIFIDevice device, UBYTE* packet, UWORD packetSize);
 //           5: 0 if this was the last packet, or 0x10 if there are more to read
 LONG SCSIWifi_receiveFrame(SCSIWIFIDevice device, UBYTE* packetBuffer, UWORD* packetSize);
 
+// As SCSIWifi_receiveFrame, but asks the DaynaPORT to pack as many frames as will fit into packetBuffer,
+// which should be SCSIWIFI_RECEIVE_BUFFER_SIZE.  Each frame is a 6 byte header (as above), the frame and its CRC, 
+// plus a pad byte if needed so the next header is word aligned.  Byte 5 has SCSIWIFI_FLAG_RECORD_FOLLOWS set if 
+// another frame follows.  The same MODE rules apply to the whole transfer as to a single frame.
+// Without BATCH=1 it asks for just one.  Firmware that doesn't support this just returns one frame, and if it
+// rejects the request single reads are used from then on.
+LONG SCSIWifi_receiveFrames(SCSIWIFIDevice device, UBYTE* packetBuffer, UWORD* packetSize);
+
+// Reading in the background, so frames from one read can be handed on while the next crosses the bus.
+// SCSIWifi_startReceive sends a read (batched if BATCH=1 and the firmware hasn't turned it down) into one of the device's own buffers
+// and returns straight away, or returns 0 if they're all in use.  SCSIWifi_collectReceive waits for the oldest
+// one and returns 1 with *packetBuffer and *packetSize laid out as SCSIWifi_receiveFrames, or 0 if it failed.
+// Either way SCSIWifi_releaseReceive must be called once the buffer has been dealt with.
+// Other SCSIWifi_ calls can be made while reads are in flight, they just queue up behind them
+LONG SCSIWifi_startReceive(SCSIWIFIDevice device);
+LONG SCSIWifi_receivesPending(SCSIWIFIDevice device);
+LONG SCSIWifi_collectReceive(SCSIWIFIDevice device, UBYTE** packetBuffer, UWORD* packetSize);
+void SCSIWifi_releaseReceive(SCSIWIFIDevice device);
+// Waits for any reads still in flight and throws their data away
+void SCSIWifi_cancelReceives(SCSIWIFIDevice device);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Hot path trace - see trace.h
+ *
+ */
+
+#include <proto/exec.h>
+#include <exec/execbase.h>
+#include <devices/timer.h>
+#include <proto/timer.h>
+#include <string.h>
+#include "compiler.h"
+#include "trace.h"
+
+#ifdef SCSIDAYNA_TRACE
+
+#define SysBase ring->tr_SysBase
+#define TimerBase ring->tr_TimerBase
+
+// Both frame_proc and the stack's tasks record, so the slot is claimed (and filled) under Forbid()
+void Trace_record(struct TraceRing* ring, UWORD event, ULONG arg, APTR request) {
+    struct EClockVal now;
+    struct TraceRecord* record;
+
+    if ((!ring) || (!ring->tr_Enabled) || (!TimerBase)) return;
+
+    Forbid();
+    ReadEClock(&now);
+    record = &ring->tr_Records[ring->tr_Next & (TRACE_EVENTS - 1)];
+    ring->tr_Next++;
+    record->tr_Time = now.ev_lo;
+    record->tr_Arg = arg;
+    record->tr_Request = (ULONG)(IPTR)request;
+    record->tr_Event = event;
+    record->tr_Task = (UWORD)(IPTR)FindTask(NULL);
+    Permit();
+}
+
+// The newest records that fit are copied, oldest first
+ULONG Trace_dump(struct TraceRing* ring, UBYTE* buffer, ULONG size) {
+    struct TraceDumpHeader header;
+    ULONG count, first, i;
+
+    if ((!ring) || (size < sizeof(header))) return 0;
+
+    Forbid();
+    count = ring->tr_Next < TRACE_EVENTS ? ring->tr_Next : TRACE_EVENTS;
+    // Records are 16 bytes, so this is a shift rather than a divide
+    if (count > ((size - sizeof(header)) >> 4)) count = (size - sizeof(header)) >> 4;
+    first = ring->tr_Next - count;
+
+    header.th_Magic = TRACE_MAGIC;
+    header.th_EClockRate = ring->tr_EClockRate;
+    header.th_Count = count;
+    header.th_Lost = first;
+    memcpy(buffer, &header, sizeof(header));
+    buffer += sizeof(header);
+
+    for (i = 0; i < count; i++) {
+        memcpy(buffer, &ring->tr_Records[(first + i) & (TRACE_EVENTS - 1)], sizeof(struct TraceRecord));
+        buffer += sizeof(struct TraceRecord);
+    }
+    Permit();
+
+    return sizeof(header) + count * sizeof(struct TraceRecord);
+}
+
+#endif /* SCSIDAYNA_TRACE */
@@ -0,0 +1,98 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * Hot path trace
+ *
+ * With SCSIDAYNA_TRACE defined (make trace=1) the driver records what it's doing,
+ * each event stamped with the EClock, into a ring buffer allocated when the
+ * device opens.  Nothing is printed and nothing is allocated while recording,
+ * and recording only happens while it's been switched on with S2_DAYNA_TRACE.
+ * Without SCSIDAYNA_TRACE the TRACE() calls compile to nothing.
+ *
+ * S2_DAYNA_TRACE:
+ *   ios2_PacketType TRACE_CTRL_* flags, done in the order listed
+ *   ios2_Data       for TRACE_CTRL_DUMP, where to copy the ring to
+ *   ios2_DataLength for TRACE_CTRL_DUMP, the room at ios2_Data. Set to the bytes copied
+ * The dump is a struct TraceDumpHeader then the events, oldest first, in the
+ * Amiga's byte order.  host/trace_decode turns it into a timeline.
+ *
+ * The device only takes one opener on unit 0, normally the TCP/IP stack, so
+ * S2_DAYNA_TRACE_UNIT can be opened alongside it, as often as wanted.  It
+ * takes S2_DAYNA_TRACE and nothing else.
+ */
+#ifndef SCSIDAYNA_TRACE_H
+#define SCSIDAYNA_TRACE_H 1
+
+#include <exec/types.h>
+
+#define S2_DAYNA_TRACE          0xDA00
+#define S2_DAYNA_TRACE_UNIT     0xDA    // opens alongside the stack, for S2_DAYNA_TRACE only
+
+#define TRACE_CTRL_DUMP         0x01    // copy what's been recorded to ios2_Data
+#define TRACE_CTRL_CLEAR        0x02    // throw away what's been recorded
+#define TRACE_CTRL_START        0x04    // start recording
+#define TRACE_CTRL_STOP         0x08    // stop recording
+
+#define TRACE_EVENTS            2048    // must be a power of 2
+#define TRACE_MAGIC             0x44545243  // 'DTRC'
+
+// What happened.  Each says what its arg is
+enum TraceEvent {
+    teNone,
+    teScsiSubmit,       // SCSI command sent, arg = opcode<<8 | sub command, or for a background read 0x10000 | ...
+    teScsiComplete,     // SCSI command finished, arg = bytes transferred, or 0xFFFFFFFF if it failed
+    teBeginIO,          // DevBeginIO, arg = io_Command
+    teTermIO,           // request replied, arg = io_Command
+    teRxLoop,           // receive loop pass starting
+    teRxFrames,         // received buffer being handed out, arg = bytes in it
+    teReadCopy,         // read_frame starting to copy a frame to the stack, arg = frame size
+    teReadCopied,       // ...done
+    teTxLoop,           // sending queued writes, arg = how many are queued (up to SCSIWIFI_TX_BATCH_MAX)
+    teWriteCopy,        // build_frame starting to copy a frame from the stack, arg = data length
+    teWriteCopied,      // ...done
+    teWait,             // frame_proc going to sleep, arg = poll interval in microseconds
+    teWake,             // ...woken, arg = signals
+    teCount
+};
+
+struct TraceRecord {
+    ULONG tr_Time;      // EClock, low word
+    ULONG tr_Arg;
+    ULONG tr_Request;   // the request this is about, or 0
+    UWORD tr_Event;     // enum TraceEvent
+    UWORD tr_Task;      // low word of the task's address, to tell frame_proc from the stack
+};
+
+struct TraceDumpHeader {
+    ULONG th_Magic;     // TRACE_MAGIC
+    ULONG th_EClockRate;
+    ULONG th_Count;     // records following
+    ULONG th_Lost;      // records overwritten before this dump
+};
+
+#ifdef SCSIDAYNA_TRACE
+
+struct TraceRing {
+    struct Library* tr_SysBase;
+    struct Library* tr_TimerBase;       // recording needs this and tr_Enabled
+    ULONG tr_EClockRate;
+    volatile UWORD tr_Enabled;
+    ULONG tr_Next;                      // total recorded, the ring slot is this & (TRACE_EVENTS-1)
+    struct TraceRecord tr_Records[TRACE_EVENTS];
+};
+
+// Records an event if tracing is on.  ring may be NULL
+void Trace_record(struct TraceRing* ring, UWORD event, ULONG arg, APTR request);
+
+// Copies up to size bytes of dump (header and records, oldest first) to buffer. Returns the bytes copied
+ULONG Trace_dump(struct TraceRing* ring, UBYTE* buffer, ULONG size);
+
+#define TRACE(ring, event, arg, request) do { if ((ring) && (ring)->tr_Enabled) Trace_record(ring, event, (ULONG)(arg), (APTR)(request)); } while(0)
+
+#else
+
+struct TraceRing;
+#define TRACE(ring, event, arg, request)
+
+#endif /* SCSIDAYNA_TRACE */
+
+#endif /* SCSIDAYNA_TRACE_H */
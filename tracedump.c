@@ -0,0 +1,80 @@
+/*
+ * SCSI DaynaPORT Device (scsidayna.device) by RobSmithDev
+ * tracedump - controls the driver's hot path trace and saves it to a file
+ *
+ *   tracedump CLEAR START          start recording from scratch
+ *   tracedump TO=RAM:trace.bin     save what's been recorded
+ *   tracedump TO=RAM:trace.bin STOP
+ *
+ * The driver has to be built with trace=1.  It opens S2_DAYNA_TRACE_UNIT, so it works
+ * while the TCP/IP stack has the device open.  Decode the file with host/trace_decode.
+ */
+
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include <exec/memory.h>
+#include <utility/tagitem.h>
+#include <string.h>
+#include "sana2.h"
+#include "trace.h"
+
+#define TEMPLATE "TO/K,START/S,STOP/S,CLEAR/S,DEVICE/K"
+enum {argTo, argStart, argStop, argClear, argDevice, argCount};
+
+int main(void) {
+    LONG args[argCount] = {0};
+    struct RDArgs* rdargs;
+    struct MsgPort* port;
+    struct IOSana2Req* req;
+    struct TagItem noBuffers[] = {{TAG_DONE, 0}};
+    ULONG size = sizeof(struct TraceDumpHeader) + TRACE_EVENTS * sizeof(struct TraceRecord);
+    UBYTE* buffer = NULL;
+    int rc = RETURN_FAIL;
+
+    if (!(rdargs = ReadArgs(TEMPLATE, args, NULL))) {
+        PrintFault(IoErr(), "tracedump");
+        return RETURN_FAIL;
+    }
+
+    if ((port = CreateMsgPort())) {
+        if ((req = (struct IOSana2Req*)CreateIORequest(port, sizeof(struct IOSana2Req)))) {
+            req->ios2_BufferManagement = noBuffers;
+            if (OpenDevice(args[argDevice] ? (STRPTR)args[argDevice] : (STRPTR)"scsidayna.device", S2_DAYNA_TRACE_UNIT, (struct IORequest*)req, 0) == 0) {
+                ULONG control = 0;
+                if (args[argTo]) {
+                    control |= TRACE_CTRL_DUMP;
+                    buffer = AllocVec(size, MEMF_PUBLIC);
+                }
+                if (args[argClear]) control |= TRACE_CTRL_CLEAR;
+                if (args[argStart]) control |= TRACE_CTRL_START;
+                if (args[argStop]) control |= TRACE_CTRL_STOP;
+
+                if ((args[argTo]) && (!buffer)) Printf("Out of memory\n"); else {
+                    req->ios2_Req.io_Command = S2_DAYNA_TRACE;
+                    req->ios2_PacketType = control;
+                    req->ios2_Data = buffer;
+                    req->ios2_DataLength = buffer ? size : 0;
+                    if (DoIO((struct IORequest*)req)) {
+                        Printf("The driver wasn't built with trace=1 (error %ld)\n", (LONG)req->ios2_Req.io_Error);
+                    } else if (buffer) {
+                        BPTR file = Open((STRPTR)args[argTo], MODE_NEWFILE);
+                        if (file) {
+                            if (Write(file, buffer, req->ios2_DataLength) == (LONG)req->ios2_DataLength) {
+                                Printf("Saved %ld events\n", ((struct TraceDumpHeader*)buffer)->th_Count);
+                                rc = RETURN_OK;
+                            } else PrintFault(IoErr(), (STRPTR)args[argTo]);
+                            Close(file);
+                        } else PrintFault(IoErr(), (STRPTR)args[argTo]);
+                    } else rc = RETURN_OK;
+                }
+                if (buffer) FreeVec(buffer);
+                CloseDevice((struct IORequest*)req);
+            } else Printf("Unable to open %s\n", args[argDevice] ? (STRPTR)args[argDevice] : (STRPTR)"scsidayna.device");
+            DeleteIORequest((struct IORequest*)req);
+        }
+        DeleteMsgPort(port);
+    }
+
+    FreeArgs(rdargs);
+    return rc;
+}